@@ -0,0 +1,50 @@
+# Writes EMBED_OUTPUT, a C++ source holding each file of EMBED_FILES as a
+# constexpr byte array, with the table resource/embedded.cpp searches.
+#
+# Run as a script:
+#   cmake -DEMBED_ROOT=<dir> -DEMBED_FILES=<a|b|...> -DEMBED_OUTPUT=<file> -P EmbedResources.cmake
+#
+# EMBED_FILES are relative to EMBED_ROOT, separated by '|', and become the
+# lookup names, so "resource/shader.vs" is found as "./resource/shader.vs".
+
+string(REPLACE "|" ";" files "${EMBED_FILES}")
+list(SORT files)
+
+set(source "// Generated by CMakeModules/EmbedResources.cmake, do not edit\n\n")
+string(APPEND source "#include \"resource/embedded.h\"\n\nnamespace {\n")
+set(table "")
+set(index 0)
+
+# Sixteen bytes to a line
+set(row "")
+foreach(i RANGE 15)
+    string(APPEND row "0x[0-9a-f][0-9a-f],")
+endforeach()
+
+foreach(name ${files})
+    file(READ "${EMBED_ROOT}/${name}" hex HEX)
+    string(LENGTH "${hex}" hex_length)
+    math(EXPR bytes "${hex_length} / 2")
+
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," array "${hex}")
+    string(REGEX REPLACE "(${row})" "\\1\n\t\t" array "${array}")
+
+    # The extra 0 terminates text files, it isn't counted in the size
+    string(APPEND source "\t// ${name}\n\talignas(16) constexpr uint8_t file_${index}[] = {\n\t\t${array}0\n\t};\n")
+    string(APPEND table "\t\t{\"${name}\", file_${index}, ${bytes}},\n")
+    math(EXPR index "${index} + 1")
+endforeach()
+
+string(APPEND source "}\n\nnamespace resource{\n")
+string(APPEND source "\t// Sorted by name, the last entry is only there so the array is never empty\n")
+string(APPEND source "\tconst embedded_file_t embedded_files[] = {\n${table}\t\t{nullptr, nullptr, 0}\n\t};\n")
+string(APPEND source "\tconst uint32_t embedded_file_count = ${index};\n}\n")
+
+# Only touch the output when it changed, so the library isn't rebuilt for nothing
+set(previous "")
+if (EXISTS "${EMBED_OUTPUT}")
+    file(READ "${EMBED_OUTPUT}" previous)
+endif ()
+if (NOT previous STREQUAL source)
+    file(WRITE "${EMBED_OUTPUT}" "${source}")
+endif ()
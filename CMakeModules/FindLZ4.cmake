@@ -0,0 +1,33 @@
+# Locate the LZ4 compression library
+#
+# This module defines:
+#   LZ4_FOUND
+#   LZ4_INCLUDE_DIRS
+#   LZ4_LIBRARIES
+#
+# $LZ4DIR is an environment variable that can point at a custom install prefix
+
+find_path(LZ4_INCLUDE_DIR lz4.h
+  HINTS
+    ENV LZ4DIR
+    ${CMAKE_SOURCE_DIR}/dep/
+  PATH_SUFFIXES include
+)
+
+find_library(LZ4_LIBRARY
+  NAMES lz4
+  HINTS
+    ENV LZ4DIR
+    ${CMAKE_SOURCE_DIR}/dep/
+  PATH_SUFFIXES lib
+)
+
+set(LZ4_LIBRARIES ${LZ4_LIBRARY})
+set(LZ4_INCLUDE_DIRS ${LZ4_INCLUDE_DIR})
+
+include(FindPackageHandleStandardArgs)
+
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(LZ4
+                                  REQUIRED_VARS LZ4_LIBRARIES LZ4_INCLUDE_DIRS)
+
+mark_as_advanced(LZ4_LIBRARY LZ4_INCLUDE_DIR)
@@ -44,10 +44,10 @@ int main(int argc, const char** argv){
 
 	challenge.api.graphics.initialize(800, 600, "Test", false);
 	challenge.api.event.initialize_handler();
-
-	// Load shader/texture
+	// Load shader/texture, the defaults are built into the library
 	uint32_t shader = load_shader("./resource/shader.vs", "./resource/shader.fs");
 	uint32_t texture = load_texture("./resource/codepage.png");
+	challenge.api.file.prefetch_mark("assets");
 
 	challenge.api.buffer.initialize(1, 1024, shader, texture);
 
@@ -139,8 +139,8 @@ int main(int argc, const char** argv){
 		challenge.api.graphics.end_render();
 	}
 
-	challenge.api.shader.destroy_program(shader);
-	challenge.api.texture.destroy(texture);
+	challenge.api.resource.release_shader(shader);
+	challenge.api.resource.release_texture(texture);
 
 	challenge.api.buffer.shutdown();
 	challenge.api.event.shutdown_handler();
@@ -152,35 +152,8 @@ int main(int argc, const char** argv){
 
 
 uint32_t load_shader(const char* vpath, const char* fpath){
-	uint32_t result = 0;
-
-	uint32_t vsz = challenge.api.file.size(vpath);
-	uint32_t fsz = challenge.api.file.size(fpath);
-	
-	uint8_t *store = new uint8_t[vsz + fsz];
-	void* vdata = store;
-	void* fdata = store + vsz;
-
-	challenge.api.file.read(vpath, vdata, vsz);
-	challenge.api.file.read(fpath, fdata, fsz);
-
-	result = challenge.api.shader.create_program(vdata, fdata, 0, vsz, fsz, 0);
-
-	delete[] store;
-
-	return result;
+	return challenge.api.resource.load_shader(vpath, fpath);
 }
 uint32_t load_texture(const char* path){
-	uint32_t result = 0;
-
-	uint32_t tsz = challenge.api.file.size(path);
-	uint8_t *store = new uint8_t[tsz];
-	void* tdata = store;
-
-	challenge.api.file.read(path, tdata, tsz);
-	result = challenge.api.texture.create_alpha(tdata, tsz);
-	
-	delete[] store;
-
-	return result;
+	return challenge.api.resource.load_texture(path, nullptr);
 }
@@ -1,8 +1,14 @@
 #include "api.h"
 
 #include "io/file.h"
+#include "io/pack.h"
+#include "io/async.h"
+#include "io/appender.h"
+#include "io/watch.h"
+#include "io/prefetch.h"
 #include "event/event.h"
 #include "memory/free.h"
+#include "memory/handle.h"
 
 #include "graphics/image.h"
 #include "graphics/renderer.h"
@@ -10,6 +16,9 @@
 #include "graphics/texture.h"
 #include "graphics/render_buffer.h"
 
+#include "resource/cache.h"
+#include "resource/embedded.h"
+
 struct api_file_t get_file_api(void){
 	struct api_file_t result = {0};
 
@@ -20,8 +29,64 @@ struct api_file_t get_file_api(void){
 	API(append);
 	API(read);
 
+	API(read_at);
+	API(write_at);
+
+	API(reader_open);
+	API(reader_close);
+	API(reader_next);
+	API(reader_read);
+	API(reader_seek);
+	API(reader_tell);
+
+	API(writer_open);
+	API(writer_close);
+	API(writer_write);
+	API(writer_flush);
+
+	API(appender_default_options);
+	API(appender_open);
+	API(appender_close);
+	API(appender_write);
+	API(appender_flush);
+
+	API(map);
+	API(unmap);
+
 	API(find);
 	API(find_recursive);
+
+	API(find_begin);
+	API(find_next);
+	API(find_end);
+	API(find_each);
+#undef API
+#define API(fn) result.fn = io::pack::fn
+	API(mount);
+	API(unmount);
+	API(view);
+#undef API
+	result.pack_stats = io::pack::stats;
+
+#define API(fn) result.watch_##fn = io::watch::fn
+	API(add);
+	API(shutdown);
+	API(poll);
+	API(lookup);
+	API(list);
+	API(subscribe);
+	API(unsubscribe);
+#undef API
+	result.prefetch_mark = io::prefetch::mark;
+
+#define API(fn) result.async_##fn = io::async::fn
+	API(initialize);
+	API(shutdown);
+	API(queue);
+	API(submit);
+	API(poll);
+	API(dispatch);
+	API(pending);
 #undef API
 
 	return result;
@@ -47,6 +112,14 @@ struct api_graphics_t get_graphics_api(void){
 	API(time_now);
 #undef API
 
+#define API(fn) result.fn = render::latency::fn
+	API(set_low_latency);
+	API(set_late_sample);
+	API(set_gpu_fences);
+#undef API
+	result.latency_stats = render::latency::stats;
+	result.latency_reset = render::latency::reset;
+
 	return result;
 }
 
@@ -58,6 +131,10 @@ struct api_image_t get_image_api(void){
 	API(load_lump);
 	API(free);
 	API(data);
+	API(load_batch);
+	API(load_lump_batch);
+	API(info);
+	API(decode);
 #undef API
 	return result;
 }
@@ -69,10 +146,34 @@ struct api_event_t get_event_api(void){
 	API(initialize_handler);
 	API(shutdown_handler);
 	API(set_event_handler);
+	API(subscribe);
+	API(unsubscribe);
 	API(call_event_handler);
+	result.post = event::post;
+	API(dispatch_posted);
 	API(poll_events);
 	API(wait_events);
 	API(wait_events_timeout);
+
+	API(set_batching);
+	API(frame_events);
+	API(frame_events_of);
+
+	API(set_coalescing);
+	API(coalesced);
+
+	API(record_begin);
+	API(record_end);
+	API(replay_begin);
+	API(replay_end);
+	API(replaying);
+
+	result.input_state = event::input::state;
+	result.input_snapshot = event::input::snapshot;
+
+	result.timer_start = event::timer::start;
+	result.timer_cancel = event::timer::cancel;
+	result.timer_next = event::timer::next;
 #undef API
 
 	return result;
@@ -102,10 +203,20 @@ struct api_shader_t get_shader_api(void){
 struct api_texture_t get_texture_api(void){
 	api_texture_t result = {0};
 #define API(fn) result.fn = texture_##fn
+	API(default_options);
 	API(create);
 	API(create_alpha);
+	API(create_ex);
+	API(create_image);
+	API(create_pixels);
+	API(create_array);
+	API(update);
 	API(destroy);
 	API(bind);
+	API(bind_array);
+	API(create_sampler);
+	API(destroy_sampler);
+	API(bind_sampler);
 #undef API
 	return result;
 }
@@ -130,10 +241,33 @@ struct api_render_buffer_t get_buffer_api(void){
 	return result;
 }
 
+struct api_resource_t get_resource_api(void){
+	api_resource_t result = {0};
+#define API(fn) result.fn = resource::fn
+	API(load_image);
+	API(load_texture);
+	API(load_shader);
+	API(release_image);
+	API(release_texture);
+	API(release_shader);
+	API(clear);
+
+	API(set_override_dir);
+	API(hot_reload);
+	API(embedded);
+#undef API
+	return result;
+}
+
 struct api_memory_t get_memory_api(void){
 	api_memory_t result = {0};
 #define API(fn) result.fn = memory_##fn
 	API(free);
+#undef API
+#define API(fn) result.fn = fn
+	API(handle_set_capacity);
+	API(handle_stats);
+	API(handle_swap);
 #undef API
 	return result;
 }
@@ -149,6 +283,7 @@ api_common_t get_common_api(void){
 	result.shader = get_shader_api();
 	result.texture = get_texture_api();
 	result.buffer = get_buffer_api();
+	result.resource = get_resource_api();
 
 	return result;
 }
\ No newline at end of file
@@ -4,6 +4,17 @@
 #pragma once
 #include <inttypes.h>
 #include "graphics/image.h"
+#include "graphics/texture.h"
+#include "graphics/latency.h"
+#include "memory/handle.h"
+#include "io/file.h"
+#include "io/pack.h"
+#include "io/async.h"
+#include "io/appender.h"
+#include "io/watch.h"
+#include "event/event.h"
+#include "event/input.h"
+#include "event/timer.h"
 
 struct RenderWindow;
 struct render_glyph;
@@ -12,17 +23,73 @@ struct uv_quad;
 
 struct api_memory_t{
 	void (*free)(void* mem);
+
+	void           (*handle_set_capacity)(handle_type_t type, uint32_t capacity);
+	handle_stats_t (*handle_stats)(handle_type_t type);
+	int            (*handle_swap)(handle_type_t type, uint32_t a, uint32_t b);
 };
 
 struct api_file_t{
 	bool     (*exists)(const char* path);
-	uint32_t (*size)  (const char* path);
-	bool     (*write) (const char* path, void* data, uint32_t bytes);
-	bool     (*append)(const char* path, void* data, uint32_t bytes);
-	uint32_t (*read)  (const char* path, void* store, uint32_t bytes);
+	uint64_t (*size)  (const char* path);
+	bool     (*write) (const char* path, void* data, uint64_t bytes);
+	bool     (*append)(const char* path, void* data, uint64_t bytes);
+	uint64_t (*read)  (const char* path, void* store, uint64_t bytes);
+
+	uint64_t (*read_at) (const char* path, void* store, uint64_t bytes, uint64_t offset);
+	bool     (*write_at)(const char* path, void* data, uint64_t bytes, uint64_t offset);
+
+	bool     (*reader_open) (file_reader_t& reader, const char* path, void* buffer, uint32_t buffer_bytes);
+	void     (*reader_close)(file_reader_t& reader);
+	bool     (*reader_next) (file_reader_t& reader, file_view_t& chunk);
+	uint64_t (*reader_read) (file_reader_t& reader, void* store, uint64_t bytes);
+	void     (*reader_seek) (file_reader_t& reader, uint64_t offset);
+	uint64_t (*reader_tell) (const file_reader_t& reader);
+
+	bool     (*writer_open) (file_writer_t& writer, const char* path, void* buffer, uint32_t buffer_bytes, bool append);
+	bool     (*writer_close)(file_writer_t& writer);
+	bool     (*writer_write)(file_writer_t& writer, const void* data, uint64_t bytes);
+	bool     (*writer_flush)(file_writer_t& writer);
+
+	appender_options_t (*appender_default_options)(void);
+	file_appender_t*   (*appender_open) (const char* path, const appender_options_t* opt);
+	bool               (*appender_close)(file_appender_t* appender);
+	bool               (*appender_write)(file_appender_t* appender, const void* data, uint32_t bytes);
+	void               (*appender_flush)(file_appender_t* appender);
+
+	bool     (*map)   (const char* path, file_view_t& view, file_access_t access);
+	void     (*unmap) (file_view_t& view);
 
 	uint32_t (*find)(const char* root, const char* ext, void* store, uint32_t store_bytes, uint32_t& store_bytes_used);
 	uint32_t (*find_recursive)(const char* root, const char* ext, void* store, uint32_t store_bytes, uint32_t& store_bytes_used);
+
+	file_find_t* (*find_begin)(const char* root, const char** patterns, uint32_t pattern_count, bool recursive);
+	bool         (*find_next) (file_find_t* it, file_match_t& match);
+	void         (*find_end)  (file_find_t* it);
+	uint32_t     (*find_each) (const char* root, const char** patterns, uint32_t pattern_count, bool recursive, find_function fn, void* user);
+
+	bool (*mount)  (const char* pack_path);
+	void (*unmount)(const char* pack_path);
+	bool (*view)   (const char* path, file_view_t& view);
+	bool (*pack_stats)(const char* pack_path, pack_stats_t& stats);
+
+	bool           (*watch_add)        (const char* root);
+	void           (*watch_shutdown)   (void);
+	uint32_t       (*watch_poll)       (void);
+	watch_lookup_t (*watch_lookup)     (const char* path, file_info_t& info);
+	bool           (*watch_list)       (const char* dir, watch_list_function fn, void* user);
+	void           (*watch_subscribe)  (watch_function fn, void* user);
+	void           (*watch_unsubscribe)(watch_function fn, void* user);
+
+	void (*prefetch_mark)(const char* phase);
+
+	bool     (*async_initialize)(uint32_t queue_depth);
+	void     (*async_shutdown)  (void);
+	uint32_t (*async_queue)     (const async_request_t& request);
+	uint32_t (*async_submit)    (void);
+	uint32_t (*async_poll)      (async_completion_t* completions, uint32_t max);
+	uint32_t (*async_dispatch)  (void);
+	uint32_t (*async_pending)   (void);
 };
 struct api_graphics_t{
 	void          (*initialize)      (int width, int height, const char* title, bool resizable);
@@ -39,6 +106,12 @@ struct api_graphics_t{
 	void          (*window_size)     (int& width, int& height);
 	void          (*drawable_size)   (int& width, int& height);
 	float         (*time_now)        (void);
+
+	void            (*set_low_latency)(bool enable, uint32_t max_frames_in_flight);
+	void            (*set_late_sample)(late_sample_function fn, void* user);
+	void            (*set_gpu_fences) (bool enable);
+	latency_stats_t (*latency_stats)  (void);
+	void            (*latency_reset)  (void);
 };
 
 struct api_image_t{
@@ -48,6 +121,12 @@ struct api_image_t{
 	uint32_t     (*load_lump) (void* data, uint32_t bytes);
 	void         (*free)      (uint32_t img);
 	image_data_t (*data)      (uint32_t img);
+
+	uint32_t     (*load_batch)     (const char** paths, uint32_t count, uint32_t* images, int32_t* status);
+	uint32_t     (*load_lump_batch)(void** data, uint32_t* data_bytes, uint32_t count, uint32_t* images, int32_t* status);
+
+	int          (*info)  (const void* data, uint32_t data_bytes, int* width, int* height);
+	int          (*decode)(const void* data, uint32_t data_bytes, image_format_t format, void* pixels, uint32_t stride);
 };
 
 struct api_event_t{
@@ -55,11 +134,35 @@ struct api_event_t{
 	void (*shutdown_handler)(void);
 
 	void (*set_event_handler)(int event_id, void (*ev_function)(void*));
+	int  (*subscribe)  (int event_id, void (*fn)(void* event_data, void* user), void* user);
+	void (*unsubscribe)(int event_id, void (*fn)(void* event_data, void* user), void* user);
 	void (*call_event_handler)(int event_id, void* event_data);
+	bool     (*post)           (int event_id, const void* payload, uint32_t bytes);
+	uint32_t (*dispatch_posted)(void);
 
 	void (*poll_events)(void);
 	void (*wait_events)(void);
 	void (*wait_events_timeout)(float timeout);
+
+	void          (*set_batching)   (bool enable);
+	event_batch_t (*frame_events)   (void);
+	event_batch_t (*frame_events_of)(int event_id);
+
+	void     (*set_coalescing)(uint32_t flags);
+	uint32_t (*coalesced)     (void);
+
+	bool (*record_begin)(const char* path);
+	bool (*record_end)  (void);
+	bool (*replay_begin)(const char* path);
+	void (*replay_end)  (void);
+	bool (*replaying)   (void);
+
+	const input_state_t* (*input_state)   (void);
+	void                 (*input_snapshot)(input_state_t* out);
+
+	uint32_t (*timer_start) (uint32_t delay_ms, uint32_t period_ms, timer_function fn, void* user);
+	void     (*timer_cancel)(uint32_t timer);
+	uint32_t (*timer_next)  (void);
 };
 
 struct api_shader_t{
@@ -84,11 +187,40 @@ struct api_shader_t{
 	void (*set_mat4)(uint32_t prog, const char* name, const float* value);
 };
 struct api_texture_t{
+	texture_options_t (*default_options)(void);
+
 	uint32_t (*create)(void* tex_data, uint32_t tex_len);
 	uint32_t (*create_alpha)(void* tex_data, uint32_t tex_len);
+	uint32_t (*create_ex)(void* tex_data, uint32_t tex_len, const texture_options_t* opt);
+	uint32_t (*create_image)(image_data_t data, const texture_options_t* opt);
+	uint32_t (*create_pixels)(const void* pixels, uint32_t width, uint32_t height, image_format_t format, uint32_t stride, const texture_options_t* opt);
+	uint32_t (*create_array)(void** tex_data, uint32_t* tex_len, uint32_t layers, const texture_options_t* opt);
+
+	void (*update)(uint32_t tex, int32_t x, int32_t y, uint32_t width, uint32_t height, const void* pixels, image_format_t format, uint32_t stride);
 
 	void (*destroy)(uint32_t tex);
 	void (*bind)(const uint32_t tex);
+	void (*bind_array)(const uint32_t tex);
+
+	uint32_t (*create_sampler)(const texture_options_t* opt);
+	void (*destroy_sampler)(uint32_t sampler);
+	void (*bind_sampler)(uint32_t unit, uint32_t sampler);
+};
+
+struct api_resource_t{
+	uint32_t (*load_image)  (const char* path);
+	uint32_t (*load_texture)(const char* path, const texture_options_t* opt);
+	uint32_t (*load_shader) (const char* vpath, const char* fpath);
+
+	void (*release_image)  (uint32_t img);
+	void (*release_texture)(uint32_t tex);
+	void (*release_shader) (uint32_t prog);
+
+	void (*clear)(void);
+
+	void (*set_override_dir)(const char* dir);
+	void (*hot_reload)(bool enable);
+	bool (*embedded)(const char* path, file_view_t& view);
 };
 
 struct api_render_buffer_t{
@@ -120,6 +252,7 @@ struct api_common_t{
     api_shader_t        shader;
     api_texture_t       texture;
     api_render_buffer_t buffer;
+    api_resource_t      resource;
 };
 
 extern "C" api_common_t get_common_api(void);
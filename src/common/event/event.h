@@ -9,16 +9,89 @@ typedef void (*event_function)(void*);
 #define EVENT_NAME(name) event_##name
 #define EVENT_FN(name) void EVENT_NAME(name)(void* data)
 
+// Subscribers get the user pointer they subscribed with next to the event data
+typedef void (*event_callback)(void* event_data, void* user);
+#define EVENT_MAX_SUBSCRIBERS 4
+
+// Events raised by the library itself, numbered from the top of SDL's user event range
+#define EVENT_LIBRARY_BASE  0xF000
+// event_data is the const async_completion_t* of a request without a callback
+#define EVENT_FILE_COMPLETE (EVENT_LIBRARY_BASE + 0)
+// event_data is the const file_change_t* of a file under a watched directory
+#define EVENT_FILE_CHANGED  (EVENT_LIBRARY_BASE + 1)
+
+// Messages posted from other threads are copied into the queue, so the
+// payload is limited, and the queue holds at most EVENT_QUEUE_CAPACITY
+#define EVENT_POST_PAYLOAD   48
+#define EVENT_QUEUE_CAPACITY 1024
+
+// Pump coalescing, see event::set_coalescing
+#define EVENT_COALESCE_MOTION 0x1
+#define EVENT_COALESCE_RESIZE 0x2
+
+union SDL_Event;
+// A run of events that stays valid until the next poll or wait
+struct event_batch_t{
+	const union SDL_Event* events;
+	uint32_t count;
+};
+
 namespace event{
 	void initialize_handler(void);
 	void shutdown_handler(void);
 
+	// The one handler of an event, replacing the previous. Null removes it
 	void set_event_handler(int event_id, event_function fn);
+	// Subscribers are called after the handler, in the order they subscribed.
+	// Returns 0 if the event already has EVENT_MAX_SUBSCRIBERS
+	int  subscribe(int event_id, event_callback fn, void* user);
+	void unsubscribe(int event_id, event_callback fn, void* user);
 	void call_event_handler(int event_id, void* event_data);
 
+	// Safe from any thread, without locking or allocating. The payload is
+	// copied and handed to the event's handlers on the main thread by the next
+	// poll or wait, which a post also wakes. False when the queue is full or
+	// the payload is over EVENT_POST_PAYLOAD
+	bool     post(int event_id, const void* payload, uint32_t bytes);
+	template<typename T>
+	inline bool post(int event_id, const T& payload){
+		static_assert(sizeof(T) <= EVENT_POST_PAYLOAD, "payload too large to post");
+		return post(event_id, &payload, sizeof(T));
+	}
+	// Runs the handlers of everything posted so far, poll and wait call this
+	uint32_t dispatch_posted(void);
+
 	void poll_events(void);
 	void wait_events(void);
 	void wait_events_timeout(float timeout);
+
+	// While batching, poll and wait take everything SDL has queued in bulk
+	// instead of calling a handler per event. The game reads the frame's
+	// events back in arrival order, or all of one type at a time
+	void set_batching(bool enable);
+	event_batch_t frame_events(void);
+	event_batch_t frame_events_of(int event_id);
+
+	// Merges back to back SDL_MOUSEMOTION events into one with the summed
+	// motion, the latest position and the first timestamp, and resize events
+	// into the latest, as polls and batched pumps take them. 0 turns it off
+	void     set_coalescing(uint32_t flags);
+	// Events merged away by the last poll or wait
+	uint32_t coalesced(void);
+
+	// Writes every event taken from SDL to a log, with the frame (poll or wait
+	// since recording began) and time it arrived. Events carrying pointers
+	// (drops, system and user events) are left out
+	bool record_begin(const char* path);
+	// False if any of the log failed to write
+	bool record_end(void);
+	// Feeds a recorded log back in place of SDL, one logged frame per poll or
+	// wait, without waiting. SDL is still pumped: quitting and closing the
+	// window are passed on live, other live events are dropped. Live input
+	// resumes when the log runs out
+	bool replay_begin(const char* path);
+	void replay_end(void);
+	bool replaying(void);
 }
 
 #endif
\ No newline at end of file
@@ -1,25 +1,523 @@
 #include "event.h"
+#include "event_queue.h"
+#include "input.h"
+#include "timer.h"
+
+#include "io/async.h"
+#include "io/file.h"
+#include "io/watch.h"
+#include "graphics/latency.h"
 
 #include <SDL.h>
 
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+	// Events copied out of SDL's queue per SDL_PeepEvents call
+	const uint32_t PEEP_CHUNK = 128;
+
+	struct event_run{
+		uint32_t type;
+		uint32_t first;
+		uint32_t count;
+	};
+	// Everything one poll or wait took from SDL while batching
+	struct event_frame{
+		std::vector<SDL_Event> events;
+		std::vector<SDL_Event> by_type;
+		// One per type present, sorted by type
+		std::vector<event_run> runs;
+	};
+
+	bool batching = false;
+	event_frame* frame = nullptr;
+
+	uint32_t coalescing = 0;
+	// Events merged away during the last poll or wait
+	uint32_t collapsed = 0;
+	// Polled events waiting to be coalesced when not batching
+	std::vector<SDL_Event>* polled = nullptr;
+
+	// Caps a wait at the next timer deadline
+	int until_timer(int wait_ms){
+		const uint32_t until = event::timer::next();
+		return until < (uint32_t)wait_ms ? (int)until : wait_ms;
+	}
+
+	inline bool is_resize(const SDL_Event& ev){
+		return ev.type == SDL_WINDOWEVENT && (ev.window.event == SDL_WINDOWEVENT_RESIZED || ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED);
+	}
+	// Folds motion into the previous motion of the same mouse and a resize
+	// into the previous one of its kind, in place. RESIZED and SIZE_CHANGED
+	// runs are tracked apart since SDL sends them in pairs. Motion and resizes
+	// keep each other apart, as does any other event, so clicks still see the
+	// position they happened at. Returns the new count
+	uint32_t coalesce(SDL_Event* events, uint32_t count){
+		if (coalescing == 0){
+			return count;
+		}
+
+		const uint32_t NONE = 0xFFFFFFFF;
+		uint32_t motion = NONE;
+		uint32_t resized = NONE;
+		uint32_t size_changed = NONE;
+		uint32_t used = 0;
+		for (uint32_t i = 0; i < count; ++i){
+			const SDL_Event& ev = events[i];
+			if (ev.type == SDL_MOUSEMOTION && (coalescing & EVENT_COALESCE_MOTION)){
+				resized = size_changed = NONE;
+				if (motion != NONE && events[motion].motion.which == ev.motion.which && events[motion].motion.windowID == ev.motion.windowID){
+					// Keeps the first timestamp, latency is measured from the oldest input
+					SDL_MouseMotionEvent& into = events[motion].motion;
+					into.state = ev.motion.state;
+					into.x = ev.motion.x;
+					into.y = ev.motion.y;
+					into.xrel += ev.motion.xrel;
+					into.yrel += ev.motion.yrel;
+					++collapsed;
+					continue;
+				}
+				motion = used;
+			}
+			else if (is_resize(ev) && (coalescing & EVENT_COALESCE_RESIZE)){
+				motion = NONE;
+				uint32_t& resize = ev.window.event == SDL_WINDOWEVENT_RESIZED ? resized : size_changed;
+				if (resize != NONE && events[resize].window.windowID == ev.window.windowID){
+					events[resize].window = ev.window;
+					++collapsed;
+					continue;
+				}
+				resize = used;
+			}
+			else{
+				motion = resized = size_changed = NONE;
+			}
+			events[used++] = ev;
+		}
+		return used;
+	}
+
+	// Event log: the magic and version, then per event its frame, the time in
+	// ms since recording began, the size of the event and the SDL_Event itself
+	// without its trailing zero bytes
+	const char     LOG_MAGIC[4] = {'E', 'V', 'L', 'G'};
+	const uint32_t LOG_VERSION = 1;
+	const uint32_t LOG_HEADER_BYTES = 8;
+	const uint32_t LOG_RECORD_BYTES = 9;
+
+	struct event_session{
+		bool recording;
+		file_writer_t writer;
+		// Polls and waits since recording began
+		uint32_t record_frame;
+		uint32_t start;
+
+		bool replaying;
+		// Streamed, logs of long sessions run to gigabytes
+		file_reader_t replay;
+		// A record whose frame hasn't come yet, its event is still unread
+		bool     has_next;
+		uint32_t next_frame;
+		uint8_t  next_size;
+		uint32_t replay_frame;
+	};
+	event_session* session = nullptr;
+
+	event_session& get_session(void){
+		if (session == nullptr){
+			session = new event_session;
+			session->recording = false;
+			session->replaying = false;
+		}
+		return *session;
+	}
+
+	// Pointers in these mean nothing once the session is over
+	bool recordable(uint32_t type){
+		return type != SDL_SYSWMEVENT && type != SDL_DROPFILE && type != SDL_DROPTEXT && type < SDL_USEREVENT;
+	}
+	void record(const SDL_Event* events, uint32_t count){
+		if (session == nullptr || !session->recording){
+			return;
+		}
+
+		uint32_t time = SDL_GetTicks() - session->start;
+		for (uint32_t i = 0; i < count; ++i){
+			if (!recordable(events[i].type)){
+				continue;
+			}
+
+			const uint8_t* bytes = (const uint8_t*)(events + i);
+			uint8_t size = sizeof(SDL_Event);
+			while (size > sizeof(events[i].type) && bytes[size - 1] == 0){
+				--size;
+			}
+
+			uint8_t record[LOG_RECORD_BYTES];
+			memcpy(record, &session->record_frame, 4);
+			memcpy(record + 4, &time, 4);
+			record[8] = size;
+			io::file::writer_write(session->writer, record, sizeof(record));
+			io::file::writer_write(session->writer, bytes, size);
+		}
+	}
+
+	// Keyboard and mouse events, the ones input latency is measured for
+	inline bool is_input(uint32_t type){
+		return (type >> 8) == (SDL_KEYDOWN >> 8) || (type >> 8) == (SDL_MOUSEMOTION >> 8);
+	}
+
+	// Every event taken, one at a time or drained in bulk, passes through here
+	void arrived(const SDL_Event& ev){
+		event::input::update(ev);
+		if (is_input(ev.type)){
+			render::latency::input(ev.common.timestamp);
+		}
+	}
+	void deliver(SDL_Event& ev){
+		arrived(ev);
+		if (batching){
+			frame->events.push_back(ev);
+			return;
+		}
+		event::call_event_handler(ev.type, &ev);
+	}
+	// An event straight from SDL. False for a wake from event::post
+	bool receive(SDL_Event& ev){
+		if (event::queue::is_wake(ev.type)){
+			return false;
+		}
+		record(&ev, 1);
+		deliver(ev);
+		return true;
+	}
+
+	// SDL keeps being pumped while replaying so the window stays responsive.
+	// Quitting and closing the window still reach the game, live input is dropped
+	void replay_live(void){
+		SDL_Event live[PEEP_CHUNK];
+		int count;
+
+		SDL_PumpEvents();
+		do{
+			count = SDL_PeepEvents(live, PEEP_CHUNK, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+			for (int i = 0; i < count; ++i){
+				if (live[i].type == SDL_QUIT || (live[i].type == SDL_WINDOWEVENT && live[i].window.event == SDL_WINDOWEVENT_CLOSE)){
+					deliver(live[i]);
+				}
+			}
+		} while (count == (int)PEEP_CHUNK);
+	}
+	// Feeds this frame's events from the log instead of SDL. False when not replaying
+	bool replay_frame(void){
+		if (session == nullptr || !session->replaying){
+			return false;
+		}
+		replay_live();
+
+		event_session& s = *session;
+		for (;;){
+			if (!s.has_next){
+				uint8_t record[LOG_RECORD_BYTES];
+				if (io::file::reader_read(s.replay, record, sizeof(record)) != sizeof(record)){
+					break;
+				}
+				memcpy(&s.next_frame, record, 4);
+				s.next_size = record[8];
+				s.has_next = true;
+			}
+			if (s.next_frame > s.replay_frame){
+				return true;
+			}
+
+			// Sizes are one byte, so any record fits
+			uint8_t bytes[256];
+			if (io::file::reader_read(s.replay, bytes, s.next_size) != s.next_size){
+				break;
+			}
+			s.has_next = false;
+
+			SDL_Event ev;
+			memset(&ev, 0, sizeof(ev));
+			memcpy(&ev, bytes, std::min<size_t>(s.next_size, sizeof(ev)));
+			deliver(ev);
+		}
+
+		printf("event: replay finished after %u frames\n", session->replay_frame);
+		event::replay_end();
+		return true;
+	}
+
+	void clear_frame(void){
+		if (!batching){
+			return;
+		}
+		if (frame == nullptr){
+			frame = new event_frame;
+		}
+		frame->events.clear();
+		frame->by_type.clear();
+		frame->runs.clear();
+	}
+	void begin_frame(void){
+		if (session){
+			session->record_frame += session->recording;
+			session->replay_frame += session->replaying;
+		}
+		event::input::begin_frame();
+		collapsed = 0;
+		clear_frame();
+	}
+	// Takes the rest of SDL's queue in bulk
+	void drain(void){
+		std::vector<SDL_Event>& events = frame->events;
+		size_t first = events.size();
+
+		SDL_PumpEvents();
+		for (;;){
+			size_t used = events.size();
+			events.resize(used + PEEP_CHUNK);
+			int count = SDL_PeepEvents(events.data() + used, PEEP_CHUNK, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+			events.resize(used + (count > 0 ? count : 0));
+			if (count < (int)PEEP_CHUNK){
+				break;
+			}
+		}
+		events.erase(std::remove_if(events.begin() + first, events.end(), [](const SDL_Event& ev){
+			return event::queue::is_wake(ev.type);
+		}), events.end());
+		events.resize(first + coalesce(events.data() + first, (uint32_t)(events.size() - first)));
+		for (size_t i = first; i < events.size(); ++i){
+			arrived(events[i]);
+		}
+		record(events.data() + first, (uint32_t)(events.size() - first));
+	}
+	// Groups the frame's events by type
+	void end_frame(void){
+		event::input::end_frame();
+		if (!batching){
+			return;
+		}
+
+		// Stable, so each type's events keep their arrival order
+		frame->by_type = frame->events;
+		std::stable_sort(frame->by_type.begin(), frame->by_type.end(), [](const SDL_Event& a, const SDL_Event& b){
+			return a.type < b.type;
+		});
+		for (uint32_t i = 0; i < frame->by_type.size(); ++i){
+			uint32_t type = frame->by_type[i].type;
+			if (frame->runs.empty() || frame->runs.back().type != type){
+				frame->runs.push_back({type, i, 0});
+			}
+			++frame->runs.back().count;
+		}
+	}
+}
+
 void event::poll_events(void){
-	SDL_Event ev;
-	while (SDL_PollEvent(&ev)){
-		call_event_handler(ev.type, &ev);
-		//quit(ev);
+	io::async::dispatch();
+	io::watch::poll();
+	dispatch_posted();
+	timer::fire();
+
+	begin_frame();
+	if (!replay_frame()){
+		if (batching){
+			drain();
+		}
+		else if (coalescing){
+			// Everything queued has to be seen before anything can be merged
+			if (polled == nullptr){
+				polled = new std::vector<SDL_Event>;
+			}
+			polled->clear();
+
+			SDL_Event ev;
+			while (SDL_PollEvent(&ev)){
+				polled->push_back(ev);
+			}
+			uint32_t count = coalesce(polled->data(), (uint32_t)polled->size());
+			for (uint32_t i = 0; i < count; ++i){
+				receive((*polled)[i]);
+			}
+		}
+		else{
+			SDL_Event ev;
+			while (SDL_PollEvent(&ev)){
+				receive(ev);
+				//quit(ev);
+			}
+		}
 	}
+	end_frame();
 }
 void event::wait_events(void){
+	io::async::dispatch();
+	io::watch::poll();
+	begin_frame();
+
+	// A replay runs at full speed, there is nothing to wait for
+	if (replay_frame()){
+		end_frame();
+		return;
+	}
+
 	SDL_Event ev;
-	if (SDL_WaitEvent(&ev)){
-		call_event_handler(ev.type, &ev);
-		//quit(ev);
+	bool woken = dispatch_posted() > 0 || timer::fire() > 0;
+	// File completions push a wake event once the wait is prepared, anything
+	// that finished just before is caught by ready
+	if (!woken && event::queue::prepare_wait() && !io::async::ready()){
+		// Sleeps no longer than the next timer
+		const uint32_t until = timer::next();
+		if (until == UINT32_MAX ? SDL_WaitEvent(&ev) : SDL_WaitEventTimeout(&ev, (int)until)){
+			receive(ev);
+			//quit(ev);
+		}
+	}
+	event::queue::end_wait();
+	io::async::dispatch();
+	io::watch::poll();
+	dispatch_posted();
+	timer::fire();
+
+	if (batching){
+		drain();
 	}
+	end_frame();
 }
 void event::wait_events_timeout(float timeout){
-	SDL_Event ev;
-	while (SDL_WaitEventTimeout(&ev, timeout)){
-		call_event_handler(ev.type, &ev);
-		//quit(ev);
+	io::async::dispatch();
+	io::watch::poll();
+
+	begin_frame();
+	if (!replay_frame()){
+		// Nothing to wait for if something was posted already or a timer fired
+		int wait_ms = dispatch_posted() == 0 && timer::fire() == 0 && event::queue::prepare_wait() && !io::async::ready() ? (int)timeout : 0;
+		wait_ms = until_timer(wait_ms);
+
+		SDL_Event ev;
+		if (batching){
+			// The first event ends the wait, the rest are taken in bulk
+			if (SDL_WaitEventTimeout(&ev, wait_ms)){
+				receive(ev);
+			}
+			drain();
+		}
+		else{
+			// A post ends the wait early
+			while (SDL_WaitEventTimeout(&ev, wait_ms) && receive(ev)){
+				wait_ms = until_timer(wait_ms);
+				//quit(ev);
+			}
+		}
+		event::queue::end_wait();
+	}
+	end_frame();
+
+	io::async::dispatch();
+	io::watch::poll();
+	dispatch_posted();
+	timer::fire();
+}
+
+void event::set_batching(bool enable){
+	batching = enable;
+	clear_frame();
+}
+void event::set_coalescing(uint32_t flags){
+	coalescing = flags;
+}
+uint32_t event::coalesced(void){
+	return collapsed;
+}
+
+event_batch_t event::frame_events(void){
+	event_batch_t result = {nullptr, 0};
+	if (batching && frame){
+		result.events = frame->events.data();
+		result.count = (uint32_t)frame->events.size();
+	}
+	return result;
+}
+event_batch_t event::frame_events_of(int event_id){
+	event_batch_t result = {nullptr, 0};
+	if (!batching || frame == nullptr){
+		return result;
 	}
-}
\ No newline at end of file
+
+	auto found = std::lower_bound(frame->runs.begin(), frame->runs.end(), (uint32_t)event_id, [](const event_run& run, uint32_t type){
+		return run.type < type;
+	});
+	if (found != frame->runs.end() && found->type == (uint32_t)event_id){
+		result.events = frame->by_type.data() + found->first;
+		result.count = found->count;
+	}
+	return result;
+}
+
+bool event::record_begin(const char* path){
+	record_end();
+
+	event_session& s = get_session();
+	if (!io::file::writer_open(s.writer, path, nullptr, 0, false)){
+		return false;
+	}
+
+	uint8_t header[LOG_HEADER_BYTES];
+	memcpy(header, LOG_MAGIC, 4);
+	memcpy(header + 4, &LOG_VERSION, 4);
+	io::file::writer_write(s.writer, header, sizeof(header));
+
+	s.recording = true;
+	s.record_frame = 0;
+	s.start = SDL_GetTicks();
+	return true;
+}
+bool event::record_end(void){
+	if (session == nullptr || !session->recording){
+		return false;
+	}
+	session->recording = false;
+	return io::file::writer_close(session->writer);
+}
+
+bool event::replay_begin(const char* path){
+	replay_end();
+
+	event_session& s = get_session();
+	if (!io::file::reader_open(s.replay, path, nullptr, 0)){
+		return false;
+	}
+
+	uint8_t header[LOG_HEADER_BYTES];
+	bool valid = io::file::reader_read(s.replay, header, sizeof(header)) == sizeof(header) && memcmp(header, LOG_MAGIC, 4) == 0;
+	if (valid){
+		uint32_t version;
+		memcpy(&version, header + 4, 4);
+		valid = version == LOG_VERSION;
+	}
+	if (!valid){
+		printf("event: %s is not an event log\n", path);
+		io::file::reader_close(s.replay);
+		return false;
+	}
+
+	s.replaying = true;
+	s.has_next = false;
+	s.replay_frame = 0;
+	return true;
+}
+void event::replay_end(void){
+	if (session == nullptr || !session->replaying){
+		return;
+	}
+	session->replaying = false;
+	io::file::reader_close(session->replay);
+}
+bool event::replaying(void){
+	return session && session->replaying;
+}
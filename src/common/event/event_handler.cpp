@@ -1,31 +1,194 @@
 #include "event.h"
+#include "event_SDL_enum.h"
+
+#include <string.h>
 #include <unordered_map>
 
 namespace {
-	typedef std::unordered_map<int, event_function> EventBindingMap;
+	// Every event id lives in a row of 16 consecutive ids. SDL starts each
+	// group of events on a row boundary, so the rows listed here cover every
+	// range SDL 2 sends, and each gets its own block of slots
+	const uint32_t ROW_BITS = 4;
+	const uint32_t ROW_SIZE = 1 << ROW_BITS;
+	const uint32_t ID_LIMIT = 0x10000;
+
+	// Newer than the copy of SDL_EventType in event_SDL_enum.h
+	const uint32_t DISPLAY_EVENTS = 0x150;
+	const uint32_t SENSOR_EVENTS  = 0x1200;
+	// SDL_RegisterEvents hands out ids from SDL_USEREVENT up, the first 64 get slots
+	const uint32_t USER_ROWS = 4;
+
+	constexpr uint32_t mapped_rows[] = {
+		SDL_QUIT,
+		DISPLAY_EVENTS,
+		SDL_WINDOWEVENT,
+		SDL_KEYDOWN,
+		SDL_MOUSEMOTION,
+		SDL_JOYAXISMOTION,
+		SDL_CONTROLLERAXISMOTION,
+		SDL_FINGERDOWN,
+		SDL_DOLLARGESTURE,
+		SDL_CLIPBOARDUPDATE,
+		SDL_DROPFILE,
+		SDL_AUDIODEVICEADDED,
+		SENSOR_EVENTS,
+		SDL_RENDER_TARGETS_RESET,
+		SDL_USEREVENT,
+		SDL_USEREVENT + ROW_SIZE,
+		SDL_USEREVENT + ROW_SIZE * 2,
+		SDL_USEREVENT + ROW_SIZE * 3,
+		EVENT_LIBRARY_BASE,
+	};
+	// Row 0 stands for every id that isn't in one of the rows above
+	const uint32_t ROW_COUNT = sizeof(mapped_rows) / sizeof(mapped_rows[0]) + 1;
+
+	struct row_table{
+		uint8_t row[ID_LIMIT >> ROW_BITS];
+
+		constexpr row_table(void) : row(){
+			for (uint32_t i = 0; i + 1 < ROW_COUNT; ++i){
+				row[mapped_rows[i] >> ROW_BITS] = (uint8_t)(i + 1);
+			}
+		}
+	};
+	constexpr row_table rows;
+
+	constexpr uint32_t slot_index(uint32_t event_id){
+		return event_id < ID_LIMIT ? rows.row[event_id >> ROW_BITS] * ROW_SIZE + (event_id & (ROW_SIZE - 1)) : 0;
+	}
+	static_assert(slot_index(SDL_QUIT) == ROW_SIZE, "SDL_QUIT opens the first mapped row");
+	static_assert(slot_index(SDL_CONTROLLERDEVICEREMAPPED) == slot_index(SDL_CONTROLLERAXISMOTION) + 5, "rows are dense");
+	static_assert(slot_index(EVENT_FILE_CHANGED) / ROW_SIZE == ROW_COUNT - 1, "library events have a row");
+	static_assert(slot_index(0x500) < ROW_SIZE, "unmapped ids fall into row 0");
+	static_assert(slot_index(SENSOR_EVENTS) >= ROW_SIZE && slot_index(DISPLAY_EVENTS) >= ROW_SIZE, "newer SDL rows are mapped");
+	static_assert(slot_index(SDL_USEREVENT + ROW_SIZE * USER_ROWS - 1) >= ROW_SIZE, "registered events have rows");
+
+	struct event_subscriber{
+		event_callback fn;
+		void* user;
+	};
+	struct event_slot{
+		event_function handler;
+		uint32_t count;
+		// Dispatches running on this slot. While above 0 unsubscribing only
+		// clears fn, and the holes are closed when the outermost one returns
+		uint32_t depth;
+		bool     holes;
+		event_subscriber subscribers[EVENT_MAX_SUBSCRIBERS];
+	};
+
+	event_slot slots[ROW_COUNT * ROW_SIZE] = {};
+	// Ids outside the mapped rows: registered events past the first 64 and
+	// anything else above SDL_USEREVENT
+	std::unordered_map<int, event_slot>* others = nullptr;
 
-	EventBindingMap *bindings = nullptr;
+	event_slot* find_slot(int event_id, bool create){
+		uint32_t index = slot_index((uint32_t)event_id);
+		if (index >= ROW_SIZE){
+			return slots + index;
+		}
 
-	EVENT_FN(null_binding){}
+		if (others == nullptr){
+			if (!create){
+				return nullptr;
+			}
+			others = new std::unordered_map<int, event_slot>;
+		}
+		if (create){
+			return &(*others)[event_id];
+		}
+		auto found = others->find(event_id);
+		return found == others->end() ? nullptr : &found->second;
+	}
+
+	// Keeps the order the rest were subscribed in
+	void compact(event_slot& slot){
+		uint32_t used = 0;
+		for (uint32_t i = 0; i < slot.count; ++i){
+			if (slot.subscribers[i].fn){
+				slot.subscribers[used++] = slot.subscribers[i];
+			}
+		}
+		slot.count = used;
+		slot.holes = false;
+	}
+
+	// Runs in place. Subscribers added by a callback are past the count taken
+	// here and wait for the next event, removed ones are skipped
+	void dispatch(event_slot& slot, void* event_data){
+		const uint32_t count = slot.count;
+		++slot.depth;
+		if (slot.handler){
+			slot.handler(event_data);
+		}
+		for (uint32_t i = 0; i < count; ++i){
+			const event_subscriber& sub = slot.subscribers[i];
+			if (sub.fn){
+				sub.fn(event_data, sub.user);
+			}
+		}
+		if (--slot.depth == 0 && slot.holes){
+			compact(slot);
+		}
+	}
 }
 
 
 void event::initialize_handler(void){
-	bindings = new EventBindingMap;
+	memset(slots, 0, sizeof(slots));
 }
 void event::shutdown_handler(void){
-	delete bindings;
-	bindings = nullptr;
+	record_end();
+	replay_end();
+	memset(slots, 0, sizeof(slots));
+	delete others;
+	others = nullptr;
 }
 
 void event::set_event_handler(int event_id, event_function fn){
-	if (!fn){
-		fn = EVENT_NAME(null_binding);
+	find_slot(event_id, true)->handler = fn;
+}
+
+int  event::subscribe(int event_id, event_callback fn, void* user){
+	event_slot& slot = *find_slot(event_id, true);
+	for (uint32_t i = 0; i < slot.count; ++i){
+		if (slot.subscribers[i].fn == fn && slot.subscribers[i].user == user){
+			return 1;
+		}
+	}
+	if (slot.count == EVENT_MAX_SUBSCRIBERS){
+		return 0;
 	}
-	(*bindings)[event_id] = fn;
+	slot.subscribers[slot.count++] = {fn, user};
+	return 1;
 }
+void event::unsubscribe(int event_id, event_callback fn, void* user){
+	event_slot* slot = find_slot(event_id, false);
+	if (slot == nullptr){
+		return;
+	}
+	for (uint32_t i = 0; i < slot->count; ++i){
+		if (slot->subscribers[i].fn == fn && slot->subscribers[i].user == user){
+			slot->subscribers[i].fn = nullptr;
+			slot->holes = true;
+			if (slot->depth == 0){
+				compact(*slot);
+			}
+			return;
+		}
+	}
+}
+
 void event::call_event_handler(int event_id, void* event_data){
-	if ((*bindings).count(event_id) > 0){
-		(*bindings)[event_id](event_data);
+	uint32_t index = slot_index((uint32_t)event_id);
+	if (index < ROW_SIZE){
+		// Map nodes stay put when other ids are added during the dispatch
+		event_slot* slot = others ? find_slot(event_id, false) : nullptr;
+		if (slot){
+			dispatch(*slot, event_data);
+		}
+		return;
 	}
-}
\ No newline at end of file
+
+	dispatch(slots[index], event_data);
+}
@@ -0,0 +1,277 @@
+#include "event.h"
+#include "event_queue.h"
+
+#include <SDL.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+	const uint32_t QUEUE_MASK = EVENT_QUEUE_CAPACITY - 1;
+	static_assert((EVENT_QUEUE_CAPACITY & QUEUE_MASK) == 0, "EVENT_QUEUE_CAPACITY must be a power of two");
+
+	// Bounded queue after Dmitry Vyukov's: each cell's sequence says whose turn
+	// it is. It equals the position when the cell is free for the producer
+	// claiming that position, and position + 1 once the message is in
+	struct alignas(64) queue_cell{
+		std::atomic<uint32_t> sequence;
+		int32_t  event_id;
+		uint32_t bytes;
+		alignas(8) uint8_t payload[EVENT_POST_PAYLOAD];
+	};
+	static_assert(sizeof(queue_cell) == 64, "a cell should be one cache line");
+
+	struct event_queue{
+		queue_cell cells[EVENT_QUEUE_CAPACITY];
+
+		// Producers race on enqueue, only the main thread touches dequeue
+		alignas(64) std::atomic<uint32_t> enqueue;
+		alignas(64) uint32_t dequeue;
+
+		// Set by the main thread while it sleeps in SDL, the first post after
+		// takes it and pushes the wake event
+		alignas(64) std::atomic<bool> waiting;
+		std::atomic<uint32_t> wake_type;
+
+		event_queue(void) : enqueue(0), dequeue(0), waiting(false), wake_type(0){
+			for (uint32_t i = 0; i < EVENT_QUEUE_CAPACITY; ++i){
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	// Static so producers can post at any time, even before initialize_handler
+	event_queue posted;
+
+	// Watches the fds given to wake_on, but only while the main thread is
+	// armed in a wait. A readable fd stays readable until its owner drains it
+	// on the next poll, so the thread disarms after one wake instead of spinning
+	struct fd_waker{
+		std::thread thread;
+		std::mutex lock;
+		std::condition_variable arm;
+		bool armed;
+		bool stopping;
+		// Breaks the poll when the wait ends or the fd set changes
+		int control;
+		std::vector<int> fds;
+	};
+	fd_waker* waker = nullptr;
+
+	void push_wake(void){
+		if (posted.waiting.load(std::memory_order_relaxed) && posted.waiting.exchange(false)){
+			SDL_Event wake;
+			memset(&wake, 0, sizeof(wake));
+			wake.type = posted.wake_type.load(std::memory_order_relaxed);
+			SDL_PushEvent(&wake);
+		}
+	}
+	void interrupt(fd_waker* w){
+		const uint64_t one = 1;
+		ssize_t n = write(w->control, &one, sizeof(one));
+		(void)n;
+	}
+
+	void waker_thread(fd_waker* w){
+		std::vector<struct pollfd> set;
+		for (;;){
+			{
+				std::unique_lock<std::mutex> guard(w->lock);
+				w->arm.wait(guard, [w]{ return w->armed || w->stopping; });
+				if (w->stopping){
+					return;
+				}
+				set.clear();
+				set.push_back({w->control, POLLIN, 0});
+				for (int fd : w->fds){
+					set.push_back({fd, POLLIN, 0});
+				}
+			}
+
+			if (poll(set.data(), set.size(), -1) < 0){
+				continue;
+			}
+			if (set[0].revents){
+				uint64_t count;
+				ssize_t n = read(w->control, &count, sizeof(count));
+				(void)n;
+			}
+			bool ready = false;
+			for (size_t i = 1; i < set.size(); ++i){
+				ready = ready || (set[i].revents != 0);
+			}
+			if (ready){
+				{
+					std::lock_guard<std::mutex> guard(w->lock);
+					w->armed = false;
+				}
+				push_wake();
+			}
+		}
+	}
+
+	bool take(queue_cell& out){
+		queue_cell& cell = posted.cells[posted.dequeue & QUEUE_MASK];
+		if (cell.sequence.load(std::memory_order_acquire) != posted.dequeue + 1){
+			return false;
+		}
+
+		out.event_id = cell.event_id;
+		out.bytes = cell.bytes;
+		memcpy(out.payload, cell.payload, cell.bytes);
+
+		// Free for the producer one lap later
+		cell.sequence.store(posted.dequeue + EVENT_QUEUE_CAPACITY, std::memory_order_release);
+		++posted.dequeue;
+		return true;
+	}
+}
+
+bool event::post(int event_id, const void* payload, uint32_t bytes){
+	if (bytes > EVENT_POST_PAYLOAD){
+		return false;
+	}
+
+	queue_cell* cell;
+	uint32_t pos = posted.enqueue.load(std::memory_order_relaxed);
+	for (;;){
+		cell = posted.cells + (pos & QUEUE_MASK);
+		int32_t turn = (int32_t)(cell->sequence.load(std::memory_order_acquire) - pos);
+		if (turn == 0){
+			if (posted.enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+				break;
+			}
+		}
+		else if (turn < 0){
+			// A whole lap behind, the main thread hasn't drained yet
+			return false;
+		}
+		else{
+			pos = posted.enqueue.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->event_id = event_id;
+	cell->bytes = bytes;
+	memcpy(cell->payload, payload, bytes);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+
+	// Pairs with the fence in prepare_wait: either this sees waiting or the
+	// main thread sees the message before it sleeps
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	push_wake();
+	return true;
+}
+
+uint32_t event::dispatch_posted(void){
+	// Only what was there on entry, handlers that post again are seen next time
+	const uint32_t end = posted.enqueue.load(std::memory_order_acquire);
+
+	uint32_t count = 0;
+	queue_cell message;
+	while (posted.dequeue != end && take(message)){
+		// Handlers get a copy, the cell is already free for the producers
+		call_event_handler(message.event_id, message.payload);
+		++count;
+	}
+	return count;
+}
+
+bool event::queue::prepare_wait(void){
+	if (posted.wake_type.load(std::memory_order_relaxed) == 0){
+		uint32_t type = SDL_RegisterEvents(1);
+		if (type == (uint32_t)-1){
+			// No user events left, waits just aren't cut short
+			return true;
+		}
+		posted.wake_type.store(type, std::memory_order_relaxed);
+	}
+
+	posted.waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	// A post that came in before waiting was set won't push a wake event
+	const queue_cell& cell = posted.cells[posted.dequeue & QUEUE_MASK];
+	if (cell.sequence.load(std::memory_order_acquire) == posted.dequeue + 1){
+		posted.waiting.store(false, std::memory_order_relaxed);
+		return false;
+	}
+	if (waker){
+		std::lock_guard<std::mutex> guard(waker->lock);
+		waker->armed = true;
+		waker->arm.notify_one();
+	}
+	return true;
+}
+void event::queue::end_wait(void){
+	posted.waiting.store(false, std::memory_order_relaxed);
+	if (waker){
+		bool was_armed;
+		{
+			std::lock_guard<std::mutex> guard(waker->lock);
+			was_armed = waker->armed;
+			waker->armed = false;
+		}
+		if (was_armed){
+			interrupt(waker);
+		}
+	}
+}
+
+bool event::queue::is_wake(uint32_t type){
+	return type != 0 && type == posted.wake_type.load(std::memory_order_relaxed);
+}
+
+void event::queue::wake(void){
+	// Pairs with the fence in prepare_wait, as for a post
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	push_wake();
+}
+void event::queue::wake_on(int fd){
+	if (waker == nullptr){
+		int control = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (control < 0){
+			return;
+		}
+		waker = new fd_waker;
+		waker->armed = false;
+		waker->stopping = false;
+		waker->control = control;
+		waker->thread = std::thread(waker_thread, waker);
+	}
+	{
+		std::lock_guard<std::mutex> guard(waker->lock);
+		waker->fds.push_back(fd);
+	}
+	interrupt(waker);
+}
+void event::queue::stop_waking_on(int fd){
+	if (waker == nullptr){
+		return;
+	}
+	bool last;
+	{
+		std::lock_guard<std::mutex> guard(waker->lock);
+		waker->fds.erase(std::remove(waker->fds.begin(), waker->fds.end(), fd), waker->fds.end());
+		last = waker->fds.empty();
+		waker->stopping = last;
+		waker->arm.notify_one();
+	}
+	interrupt(waker);
+
+	// The thread is only kept while something is watched, so none outlives the library
+	if (last){
+		waker->thread.join();
+		close(waker->control);
+		delete waker;
+		waker = nullptr;
+	}
+}
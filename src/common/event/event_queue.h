@@ -0,0 +1,28 @@
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * How the SDL pump waits on the cross-thread queue behind event::post.
+ * SDL can only be woken by an event in its own queue, so a post pushes one
+ * of these wake events, but only while the main thread is asleep in a wait.
+ * Completions and file changes that arrive outside SDL end a wait the same way.
+ **/
+namespace event{ namespace queue{
+	// Call before blocking in SDL. False means something was posted already
+	// and the wait should be skipped
+	bool prepare_wait(void);
+	void end_wait(void);
+
+	// The pump drops wake events, they carry nothing
+	bool is_wake(uint32_t type);
+
+	// Ends the main thread's wait from any thread, as a post does, without a
+	// message. Nothing happens while it isn't waiting
+	void wake(void);
+	// A waiting main thread is also woken when fd turns readable, watched by a
+	// helper thread that only polls while the main thread waits. The owner
+	// drains fd on its next poll and must stop before closing it
+	void wake_on(int fd);
+	void stop_waking_on(int fd);
+}}
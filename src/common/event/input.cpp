@@ -0,0 +1,117 @@
+#include "input.h"
+#include "event_SDL_type.h"
+
+#include <string.h>
+
+#include <atomic>
+
+namespace {
+	// What the pump is building, read directly by the main thread
+	input_state_t current = {};
+
+	// Two published copies. Each has a sequence number that is odd while
+	// it is being written, so a reader that raced the writer can tell and
+	// go again from the other, finished copy
+	struct published_state{
+		std::atomic<uint32_t> sequence;
+		input_state_t state;
+	};
+	published_state published[2];
+	std::atomic<uint32_t> latest(0);
+
+	inline void set_bit(uint64_t* words, uint32_t scancode){
+		words[(scancode >> 6) & (INPUT_KEY_WORDS - 1)] |= 1ull << (scancode & 63);
+	}
+	inline void clear_bit(uint64_t* words, uint32_t scancode){
+		words[(scancode >> 6) & (INPUT_KEY_WORDS - 1)] &= ~(1ull << (scancode & 63));
+	}
+	inline uint32_t button_bit(uint8_t button){
+		return 1u << ((button - 1) & 31);
+	}
+}
+
+const input_state_t* event::input::state(void){
+	return &current;
+}
+
+void event::input::snapshot(input_state_t* out){
+	for (;;){
+		const published_state& p = published[latest.load(std::memory_order_acquire)];
+
+		uint32_t before = p.sequence.load(std::memory_order_acquire);
+		memcpy(out, &p.state, sizeof(input_state_t));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint32_t after = p.sequence.load(std::memory_order_relaxed);
+
+		if (before == after && (before & 1) == 0){
+			return;
+		}
+	}
+}
+
+void event::input::begin_frame(void){
+	memset(current.pressed, 0, sizeof(current.pressed));
+	memset(current.released, 0, sizeof(current.released));
+	current.buttons_pressed = 0;
+	current.buttons_released = 0;
+	current.delta_x = current.delta_y = 0;
+	current.wheel_x = current.wheel_y = 0;
+	++current.frame;
+}
+
+void event::input::update(const SDL_Event& ev){
+	switch (ev.type){
+		case SDL_KEYDOWN:{
+			// Repeats aren't new presses
+			if (!ev.key.repeat){
+				set_bit(current.keys, ev.key.keysym.scancode);
+				set_bit(current.pressed, ev.key.keysym.scancode);
+			}
+			break;
+		}
+		case SDL_KEYUP:{
+			clear_bit(current.keys, ev.key.keysym.scancode);
+			set_bit(current.released, ev.key.keysym.scancode);
+			break;
+		}
+		case SDL_MOUSEMOTION:{
+			current.mouse_x = ev.motion.x;
+			current.mouse_y = ev.motion.y;
+			current.delta_x += ev.motion.xrel;
+			current.delta_y += ev.motion.yrel;
+			break;
+		}
+		case SDL_MOUSEBUTTONDOWN:{
+			current.buttons |= button_bit(ev.button.button);
+			current.buttons_pressed |= button_bit(ev.button.button);
+			current.mouse_x = ev.button.x;
+			current.mouse_y = ev.button.y;
+			break;
+		}
+		case SDL_MOUSEBUTTONUP:{
+			current.buttons &= ~button_bit(ev.button.button);
+			current.buttons_released |= button_bit(ev.button.button);
+			current.mouse_x = ev.button.x;
+			current.mouse_y = ev.button.y;
+			break;
+		}
+		case SDL_MOUSEWHEEL:{
+			current.wheel_x += ev.wheel.x;
+			current.wheel_y += ev.wheel.y;
+			break;
+		}
+	}
+}
+
+void event::input::end_frame(void){
+	// Writes the copy readers aren't being sent to, then points them at it
+	uint32_t next = latest.load(std::memory_order_relaxed) ^ 1;
+	published_state& p = published[next];
+
+	p.sequence.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&p.state, &current, sizeof(input_state_t));
+	p.sequence.fetch_add(1, std::memory_order_release);
+
+	latest.store(next, std::memory_order_release);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <inttypes.h>
+
+union SDL_Event;
+
+#define INPUT_KEY_WORDS 8
+
+/**
+ * Keyboard and mouse state as of the last poll or wait, kept up to date by
+ * the pump from the events it takes, so game code can ask what is held
+ * instead of tracking it from handlers.
+ *
+ * Keys are bits indexed by SDL_Scancode, mouse buttons are SDL_BUTTON(n)
+ * bits. pressed and released hold the edges seen during the frame, so a
+ * tap shorter than a frame shows up in both while held stays clear.
+ **/
+struct input_state_t{
+	uint64_t keys    [INPUT_KEY_WORDS];
+	uint64_t pressed [INPUT_KEY_WORDS];
+	uint64_t released[INPUT_KEY_WORDS];
+
+	uint32_t buttons;
+	uint32_t buttons_pressed;
+	uint32_t buttons_released;
+
+	int32_t  mouse_x, mouse_y;
+	// Motion and wheel summed over the frame
+	int32_t  delta_x, delta_y;
+	int32_t  wheel_x, wheel_y;
+
+	// Polls and waits so far, tells snapshots apart
+	uint32_t frame;
+};
+
+// Branch free, any scancode below SDL_NUM_SCANCODES
+inline bool input_key_held(const input_state_t& s, uint32_t scancode){
+	return (s.keys[(scancode >> 6) & (INPUT_KEY_WORDS - 1)] >> (scancode & 63)) & 1;
+}
+inline bool input_key_pressed(const input_state_t& s, uint32_t scancode){
+	return (s.pressed[(scancode >> 6) & (INPUT_KEY_WORDS - 1)] >> (scancode & 63)) & 1;
+}
+inline bool input_key_released(const input_state_t& s, uint32_t scancode){
+	return (s.released[(scancode >> 6) & (INPUT_KEY_WORDS - 1)] >> (scancode & 63)) & 1;
+}
+// button is SDL_BUTTON_LEFT and so on
+inline bool input_button_held(const input_state_t& s, uint32_t button){
+	return (s.buttons >> ((button - 1) & 31)) & 1;
+}
+inline bool input_button_pressed(const input_state_t& s, uint32_t button){
+	return (s.buttons_pressed >> ((button - 1) & 31)) & 1;
+}
+inline bool input_button_released(const input_state_t& s, uint32_t button){
+	return (s.buttons_released >> ((button - 1) & 31)) & 1;
+}
+
+namespace event{ namespace input{
+	// The main thread's view, valid until the next poll or wait
+	const input_state_t* state(void);
+	// Copies out the state as of the end of the last poll or wait. Safe from
+	// any thread while the main thread keeps pumping
+	void snapshot(input_state_t* out);
+
+	// Called by the pump
+	void begin_frame(void);
+	void update(const SDL_Event& ev);
+	void end_frame(void);
+}}
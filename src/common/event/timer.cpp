@@ -0,0 +1,302 @@
+#include "timer.h"
+
+#include "memory/handle.h"
+
+#include <SDL.h>
+
+#include <vector>
+
+namespace {
+	// Layout after William Ahern's timeout wheel. A timer sits on the level
+	// of the highest bit where its deadline differs from now, in the slot
+	// those bits select, and cascades down a level each time that slot is
+	// reached until it is due
+	const uint32_t WHEEL_BITS = 6;
+	const uint32_t WHEEL_SLOTS = 1 << WHEEL_BITS;
+	const uint32_t WHEEL_MASK = WHEEL_SLOTS - 1;
+	const uint32_t WHEEL_LEVELS = 4;
+	// Further out than this is clamped and cascades again from the top
+	const uint64_t WHEEL_RANGE = (1ull << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+	const uint32_t NO_TIMER = 0xFFFFFFFF;
+	// Where a timer is linked, a wheel slot or one of these
+	const uint32_t LIST_DUE = WHEEL_LEVELS * WHEEL_SLOTS;
+	const uint32_t LIST_NONE = LIST_DUE + 1;
+
+	// Games keep thousands of timers, well past the default handle pool
+	const uint32_t TIMER_CAPACITY = 1 << 16;
+
+	struct timer_node{
+		uint64_t expires;
+		uint32_t period;
+		timer_function fn;
+		void* user;
+		uint32_t handle;
+
+		uint32_t list;
+		uint32_t prev;
+		uint32_t next;
+	};
+
+	struct timer_wheel{
+		uint64_t now;
+		uint64_t start;
+		// Bit per non empty slot, so nothing scans empty ones
+		uint64_t occupied[WHEEL_LEVELS];
+		uint32_t heads[WHEEL_LEVELS * WHEEL_SLOTS + 1];
+
+		std::vector<timer_node> nodes;
+		uint32_t free_head;
+	};
+	timer_wheel* wheel = nullptr;
+
+	uint64_t clock_ms(void){
+		uint64_t frequency = SDL_GetPerformanceFrequency() / 1000;
+		return SDL_GetPerformanceCounter() / (frequency ? frequency : 1);
+	}
+
+	timer_wheel& get_wheel(void){
+		if (wheel == nullptr){
+			wheel = new timer_wheel;
+			wheel->start = clock_ms();
+			wheel->now = 0;
+			wheel->free_head = NO_TIMER;
+			handle_set_capacity(HANDLE_TIMER, TIMER_CAPACITY);
+			for (uint32_t i = 0; i < WHEEL_LEVELS; ++i){
+				wheel->occupied[i] = 0;
+			}
+			for (uint32_t& head : wheel->heads){
+				head = NO_TIMER;
+			}
+		}
+		return *wheel;
+	}
+
+	inline uint64_t rotl(uint64_t v, uint32_t n){
+		n &= 63;
+		return n ? (v << n) | (v >> (64 - n)) : v;
+	}
+	inline uint64_t rotr(uint64_t v, uint32_t n){
+		n &= 63;
+		return n ? (v >> n) | (v << (64 - n)) : v;
+	}
+
+	void link(timer_wheel& w, uint32_t index, uint32_t list){
+		timer_node& node = w.nodes[index];
+		node.list = list;
+		node.prev = NO_TIMER;
+		node.next = w.heads[list];
+		if (node.next != NO_TIMER){
+			w.nodes[node.next].prev = index;
+		}
+		w.heads[list] = index;
+
+		if (list < LIST_DUE){
+			w.occupied[list / WHEEL_SLOTS] |= 1ull << (list & WHEEL_MASK);
+		}
+	}
+	void unlink(timer_wheel& w, uint32_t index){
+		timer_node& node = w.nodes[index];
+		if (node.list == LIST_NONE){
+			return;
+		}
+
+		if (node.prev != NO_TIMER){
+			w.nodes[node.prev].next = node.next;
+		}
+		else{
+			w.heads[node.list] = node.next;
+		}
+		if (node.next != NO_TIMER){
+			w.nodes[node.next].prev = node.prev;
+		}
+
+		if (node.list < LIST_DUE && w.heads[node.list] == NO_TIMER){
+			w.occupied[node.list / WHEEL_SLOTS] &= ~(1ull << (node.list & WHEEL_MASK));
+		}
+		node.list = LIST_NONE;
+	}
+
+	void schedule(timer_wheel& w, uint32_t index){
+		const uint64_t expires = w.nodes[index].expires;
+		if (expires <= w.now){
+			link(w, index, LIST_DUE);
+			return;
+		}
+
+		uint64_t remaining = expires - w.now;
+		if (remaining > WHEEL_RANGE){
+			remaining = WHEEL_RANGE;
+		}
+		const uint32_t level = (63 - __builtin_clzll(remaining)) / WHEEL_BITS;
+		// Above level 0 a slot is reached at its start, one before the deadline's
+		const uint32_t slot = WHEEL_MASK & ((expires >> (level * WHEEL_BITS)) - (level != 0));
+		link(w, index, level * WHEEL_SLOTS + slot);
+	}
+
+	// Moves the wheel to now, rescheduling every slot passed on the way, which
+	// either drops a timer a level or puts it on the due list
+	void advance(timer_wheel& w, uint64_t now){
+		if (now <= w.now){
+			return;
+		}
+
+		uint32_t todo = NO_TIMER;
+		uint64_t elapsed = now - w.now;
+		for (uint32_t level = 0; level < WHEEL_LEVELS; ++level){
+			const uint32_t shift = level * WHEEL_BITS;
+			uint64_t pending;
+			if ((elapsed >> shift) > WHEEL_MASK){
+				pending = ~0ull;
+			}
+			else{
+				const uint64_t steps = WHEEL_MASK & (elapsed >> shift);
+				const uint32_t from = WHEEL_MASK & (w.now >> shift);
+				const uint32_t to = WHEEL_MASK & (now >> shift);
+				pending = rotl((1ull << steps) - 1, from);
+				pending |= rotr(rotl((1ull << steps) - 1, to), steps);
+				pending |= 1ull << to;
+			}
+
+			uint64_t take = pending & w.occupied[level];
+			while (take){
+				const uint32_t slot = __builtin_ctzll(take);
+				take &= take - 1;
+
+				uint32_t index = w.heads[level * WHEEL_SLOTS + slot];
+				while (index != NO_TIMER){
+					uint32_t next = w.nodes[index].next;
+					unlink(w, index);
+					w.nodes[index].next = todo;
+					todo = index;
+					index = next;
+				}
+			}
+
+			// Only a wrap past slot 0 moves the level above
+			if ((pending & 1) == 0){
+				break;
+			}
+			const uint64_t lap = (uint64_t)WHEEL_SLOTS << shift;
+			if (elapsed < lap){
+				elapsed = lap;
+			}
+		}
+
+		w.now = now;
+		while (todo != NO_TIMER){
+			uint32_t next = w.nodes[todo].next;
+			schedule(w, todo);
+			todo = next;
+		}
+	}
+
+	void release(timer_wheel& w, uint32_t index){
+		handle_free(HANDLE_TIMER, w.nodes[index].handle);
+		w.nodes[index].handle = 0;
+		w.nodes[index].next = w.free_head;
+		w.free_head = index;
+	}
+}
+
+uint32_t event::timer::start(uint32_t delay_ms, uint32_t period_ms, timer_function fn, void* user){
+	timer_wheel& w = get_wheel();
+	advance(w, clock_ms() - w.start);
+
+	uint32_t index = w.free_head;
+	if (index != NO_TIMER){
+		w.free_head = w.nodes[index].next;
+	}
+	else{
+		index = (uint32_t)w.nodes.size();
+		w.nodes.push_back(timer_node());
+	}
+
+	uint32_t handle = handle_alloc(HANDLE_TIMER, index, 0);
+	if (handle == 0){
+		w.nodes[index].next = w.free_head;
+		w.free_head = index;
+		return 0;
+	}
+
+	timer_node& node = w.nodes[index];
+	node.expires = w.now + delay_ms;
+	node.period = period_ms;
+	node.fn = fn;
+	node.user = user;
+	node.handle = handle;
+	node.list = LIST_NONE;
+	schedule(w, index);
+	return handle;
+}
+
+void event::timer::cancel(uint32_t timer){
+	if (wheel == nullptr || !handle_valid(HANDLE_TIMER, timer)){
+		return;
+	}
+	uint32_t index = (uint32_t)handle_get(HANDLE_TIMER, timer);
+	unlink(*wheel, index);
+	release(*wheel, index);
+}
+
+uint32_t event::timer::fire(void){
+	if (wheel == nullptr){
+		return 0;
+	}
+	timer_wheel& w = *wheel;
+	advance(w, clock_ms() - w.start);
+
+	uint32_t count = 0;
+	while (w.heads[LIST_DUE] != NO_TIMER){
+		const uint32_t index = w.heads[LIST_DUE];
+		unlink(w, index);
+
+		// Re-armed before the call, so the callback can cancel it
+		timer_node node = w.nodes[index];
+		if (node.period){
+			// A late periodic timer catches up once rather than firing for every missed period
+			uint64_t expires = node.expires + node.period;
+			w.nodes[index].expires = expires > w.now ? expires : w.now + node.period;
+			schedule(w, index);
+		}
+		else{
+			release(w, index);
+		}
+
+		node.fn(node.user, node.handle);
+		++count;
+	}
+	return count;
+}
+
+uint32_t event::timer::next(void){
+	if (wheel == nullptr){
+		return UINT32_MAX;
+	}
+	timer_wheel& w = *wheel;
+	if (w.heads[LIST_DUE] != NO_TIMER){
+		return 0;
+	}
+
+	// The first occupied slot of each level bounds its timers from below
+	uint64_t result = UINT64_MAX;
+	uint64_t below = 0;
+	for (uint32_t level = 0; level < WHEEL_LEVELS; ++level){
+		const uint32_t shift = level * WHEEL_BITS;
+		if (w.occupied[level]){
+			const uint32_t slot = WHEEL_MASK & (w.now >> shift);
+			uint64_t until = (uint64_t)(__builtin_ctzll(rotr(w.occupied[level], slot)) + (level != 0)) << shift;
+			until -= below & w.now;
+			result = until < result ? until : result;
+		}
+		below = (below << WHEEL_BITS) | WHEEL_MASK;
+	}
+	if (result == UINT64_MAX){
+		return UINT32_MAX;
+	}
+
+	// Measured from when the wheel last moved, so take off the time since
+	const uint64_t now = clock_ms() - w.start;
+	const uint64_t spent = now - w.now;
+	return result > spent ? (uint32_t)(result - spent < UINT32_MAX ? result - spent : UINT32_MAX - 1) : 0;
+}
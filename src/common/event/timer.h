@@ -0,0 +1,28 @@
+#pragma once
+
+#include <inttypes.h>
+
+// timer is the handle start returned, so one function can serve several timers
+typedef void (*timer_function)(void* user, uint32_t timer);
+
+/**
+ * Timers on a hierarchical wheel: four levels of 64 slots at 1 ms, 64 ms,
+ * 4 s and 4.5 min resolution. Starting and cancelling a timer is O(1), and
+ * one that isn't due costs nothing until its slot comes round. Timers fire
+ * on the main thread from poll_events and the waits, which sleep no longer
+ * than the next deadline.
+ *
+ * Main thread only, like the rest of the event loop.
+ **/
+namespace event{ namespace timer{
+	// Calls fn after delay_ms, then every period_ms if that isn't 0.
+	// Returns a handle, 0 when the timer pool is full
+	uint32_t start (uint32_t delay_ms, uint32_t period_ms, timer_function fn, void* user);
+	// Stale handles are ignored, so a one shot timer can be cancelled after it fired
+	void     cancel(uint32_t timer);
+
+	// Runs everything that is due, returns how many fired. The pump calls this
+	uint32_t fire(void);
+	// Milliseconds until the next timer may be due, never late. UINT32_MAX with none pending
+	uint32_t next(void);
+}}
@@ -3,11 +3,25 @@
 
 #include <inttypes.h>
 
+typedef enum {
+	IMAGE_FORMAT_RGBA8 = 0,
+	IMAGE_FORMAT_RGB8,
+	IMAGE_FORMAT_R8
+} image_format_t;
+
 typedef struct {
 	int width, height, bpp;
 	void* data;
+	// Bytes per row, may be larger than width * bpp
+	int pitch;
 } image_data_t;
 
+typedef enum {
+	IMAGE_OK = 0,
+	IMAGE_ERROR_DECODE,
+	IMAGE_ERROR_FULL
+} image_status_t;
+
 #ifdef __cplusplus
 #define EXTERN extern "C" 
 #else
@@ -19,7 +33,17 @@ EXTERN void         image_initialize(void);
 EXTERN uint32_t     image_load_lump(void* data, uint32_t data_bytes);
 EXTERN uint32_t     image_load(const char* path);
 EXTERN void         image_free(uint32_t img);
+
+// Decode count images across the worker threads. images[i] receives the handle or 0,
+// status[i] (optional) the image_status_t of each item. Returns the number loaded.
+EXTERN uint32_t     image_load_batch(const char** paths, uint32_t count, uint32_t* images, int32_t* status);
+EXTERN uint32_t     image_load_lump_batch(void** data, uint32_t* data_bytes, uint32_t count, uint32_t* images, int32_t* status);
 EXTERN image_data_t image_data(uint32_t img);
 
+// PNG only. Decodes straight into caller memory in the requested format, pixels must
+// hold height * stride bytes, stride 0 for tightly packed rows. Return 0 on failure
+EXTERN int          image_info  (const void* data, uint32_t data_bytes, int* width, int* height);
+EXTERN int          image_decode(const void* data, uint32_t data_bytes, image_format_t format, void* pixels, uint32_t stride);
+
 #undef EXTERN
 #endif
\ No newline at end of file
@@ -1,21 +1,118 @@
 #include "image.h"
 #include "renderer.h"
+#include "memory/handle.h"
+#include "task/parallel.h"
+#include "io/file.h"
 
 #include <SDL.h>
 #include <SDL_image.h>
 
 #include <stdio.h>
 
+#include <vector>
+
 namespace {
-	SDL_Surface *open[64] = {0};
+	inline SDL_Surface* get_surface(uint32_t img){
+		return (SDL_Surface*)handle_get(HANDLE_IMAGE, img);
+	}
+	// Takes ownership of the decoded surface, converting it to ABGR8888.
+	// Safe to call from worker threads
+	SDL_Surface* convert_surface(SDL_Surface* temp){
+		if (temp == nullptr){
+			printf("image: failed to decode\nIMG_Load: %s\n", IMG_GetError());
+			return nullptr;
+		}
+
+		SDL_Surface *image = SDL_ConvertSurfaceFormat(temp, SDL_PIXELFORMAT_ABGR8888, 0);
+		SDL_FreeSurface(temp);
+		return image;
+	}
+	// Takes ownership of the converted surface
+	uint32_t store_surface(SDL_Surface* image){
+		if (image == nullptr){
+			return 0;
+		}
+
+		uint32_t ndx = handle_alloc(HANDLE_IMAGE, (uintptr_t)image, (uint64_t)image->pitch * image->h);
+		if (ndx == 0){
+			printf("image: handle pool full (%u images)\n", handle_stats(HANDLE_IMAGE).capacity);
+			SDL_FreeSurface(image);
+		}
+		return ndx;
+	}
+
+	// PNGs decode straight into a surface of the final format. Anything else
+	// goes through SDL_image and a conversion
+	SDL_Surface* decode_lump(void* data, uint32_t data_bytes){
+		int width, height;
+		if (image_info(data, data_bytes, &width, &height)){
+			// IMAGE_FORMAT_RGBA8 is R,G,B,A in memory, which is ABGR8888 on little endian
+			SDL_Surface* image = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ABGR8888);
+			if (image && image_decode(data, data_bytes, IMAGE_FORMAT_RGBA8, image->pixels, image->pitch)){
+				return image;
+			}
+			printf("image: failed to decode PNG\n");
+			SDL_FreeSurface(image);
+			return nullptr;
+		}
+
+		SDL_RWops *rw = SDL_RWFromMem(data, data_bytes);
+		return convert_surface(IMG_Load_RW(rw, 1));
+	}
+	SDL_Surface* decode_path(const char* path){
+		// The compressed file is a fraction of the decoded size, so reading it
+		// whole keeps files and lumps on the same decode path
+		uint64_t bytes = io::file::size_on_disk(path);
+		if (bytes == 0 || bytes > UINT32_MAX){
+			printf("image: could not read %s\n", path);
+			return nullptr;
+		}
+
+		// Pool threads live across batches, so each keeps its read buffer at the
+		// largest file it has seen instead of allocating one per image
+		static thread_local std::vector<uint8_t> data;
+		if (data.size() < bytes){
+			data.resize(bytes);
+		}
+		bytes = io::file::read(path, data.data(), bytes);
+		return decode_lump(data.data(), bytes);
+	}
+
+	struct batch_t{
+		const char** paths;
+		void** data;
+		uint32_t* data_bytes;
+		// One slot per item, filled by the workers
+		SDL_Surface** surfaces;
+	};
+	// Batches are loaded from the main thread, the slots are kept between them
+	std::vector<SDL_Surface*> batch_surfaces;
+	void batch_decode_path(void* user, uint32_t ndx){
+		batch_t* batch = (batch_t*)user;
+		batch->surfaces[ndx] = decode_path(batch->paths[ndx]);
+	}
+	void batch_decode_lump(void* user, uint32_t ndx){
+		batch_t* batch = (batch_t*)user;
+		batch->surfaces[ndx] = decode_lump(batch->data[ndx], batch->data_bytes[ndx]);
+	}
+	// Handles are only touched on the calling thread once every decode is done
+	uint32_t load_batch(batch_t& batch, uint32_t count, task::parallel_function decode, uint32_t* images, int32_t* status){
+		if (batch_surfaces.size() < count){
+			batch_surfaces.resize(count);
+		}
+		batch.surfaces = batch_surfaces.data();
+		task::parallel_for(count, decode, &batch);
 
-	uint32_t get_open_ndx(void){
-		for (uint32_t i = 1; i < 64; ++i){
-			if (open[i] == nullptr){
-				return i;
+		uint32_t loaded = 0;
+		for (uint32_t i = 0; i < count; ++i){
+			images[i] = store_surface(batch.surfaces[i]);
+			loaded += (images[i] != 0);
+			if (status){
+				status[i] = images[i] ? IMAGE_OK : (batch.surfaces[i] ? IMAGE_ERROR_FULL : IMAGE_ERROR_DECODE);
 			}
 		}
-		return 0;
+
+		return loaded;
 	}
 }
 
@@ -28,45 +125,43 @@ void         image_initialize(void){
 }
 
 uint32_t     image_load_lump(void* data, uint32_t data_bytes){
-	SDL_RWops *rw = SDL_RWFromMem(data, data_bytes);
-    SDL_Surface *temp = IMG_Load_RW(rw, 1);
-
-    // Assumes success
-    uint32_t ndx = get_open_ndx();
-
-    SDL_Surface *image = SDL_ConvertSurfaceFormat(temp, SDL_PIXELFORMAT_ABGR8888, 0);
-    SDL_FreeSurface(temp);
-
-    open[ndx] = image;
-
-    return ndx;
+	return store_surface(decode_lump(data, data_bytes));
 }
 uint32_t     image_load(const char* path){
-	SDL_Surface *temp = IMG_Load(path);
-
-	// Assumes success
-	uint32_t ndx = get_open_ndx();
-	
-	//SDL_Surface *image = SDL_ConvertSurfaceFormat(temp, SDL_GetWindowPixelFormat((SDL_Window*)render::get_window()), 0);
-	SDL_Surface *image = SDL_ConvertSurfaceFormat(temp, SDL_PIXELFORMAT_ABGR8888, 0);
-	SDL_FreeSurface(temp);
-
-	open[ndx] = image;
-	return ndx;
+	return store_surface(decode_path(path));
 }
 void         image_free(uint32_t img){
-	SDL_FreeSurface(open[img]);
-	open[img] = nullptr;
+	SDL_Surface* surface = get_surface(img);
+	if (surface){
+		SDL_FreeSurface(surface);
+		handle_free(HANDLE_IMAGE, img);
+	}
+}
+
+uint32_t     image_load_batch(const char** paths, uint32_t count, uint32_t* images, int32_t* status){
+	batch_t batch = {0};
+	batch.paths = paths;
+	return load_batch(batch, count, batch_decode_path, images, status);
+}
+uint32_t     image_load_lump_batch(void** data, uint32_t* data_bytes, uint32_t count, uint32_t* images, int32_t* status){
+	batch_t batch = {0};
+	batch.data = data;
+	batch.data_bytes = data_bytes;
+	return load_batch(batch, count, batch_decode_lump, images, status);
 }
 
 image_data_t image_data(uint32_t img){
-	const SDL_Surface* surface = open[img];
+	const SDL_Surface* surface = get_surface(img);
 
 	image_data_t result = {0};
+	if (surface == nullptr){
+		return result;
+	}
 	result.width = surface->w;
 	result.height = surface->h;
 	result.bpp = surface->format->BytesPerPixel;
 	result.data = surface->pixels;
+	result.pitch = surface->pitch;
 
 	return result;
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "image.h"
+
+#include <png.h>
+#include <string.h>
+
+namespace {
+	// Indexed by image_format_t
+	const png_uint_32 png_format[] = {PNG_FORMAT_RGBA, PNG_FORMAT_RGB, PNG_FORMAT_GRAY};
+	const uint32_t format_bytes[] = {4, 3, 1};
+
+	bool begin_read(png_image& image, const void* data, uint32_t data_bytes){
+		if (data_bytes < 8 || png_sig_cmp((png_const_bytep)data, 0, 8) != 0){
+			return false;
+		}
+
+		memset(&image, 0, sizeof(image));
+		image.version = PNG_IMAGE_VERSION;
+
+		return png_image_begin_read_from_memory(&image, data, data_bytes) != 0;
+	}
+}
+
+int          image_info(const void* data, uint32_t data_bytes, int* width, int* height){
+	png_image image;
+	if (!begin_read(image, data, data_bytes)){
+		return 0;
+	}
+
+	*width = image.width;
+	*height = image.height;
+
+	png_image_free(&image);
+	return 1;
+}
+
+int          image_decode(const void* data, uint32_t data_bytes, image_format_t format, void* pixels, uint32_t stride){
+	png_image image;
+	if (!begin_read(image, data, data_bytes)){
+		return 0;
+	}
+
+	// libpng does the unfiltering (SIMD where it was built with it), palette
+	// and tRNS expansion and channel conversion while writing each row
+	// straight into the destination, so there is no intermediate image
+	image.format = png_format[format];
+	if (stride == 0){
+		stride = image.width * format_bytes[format];
+	}
+
+	// Dropping alpha composites onto black rather than onto whatever is in pixels
+	const png_color black = {0, 0, 0};
+
+	int result = png_image_finish_read(&image, &black, pixels, (png_int_32)stride, nullptr);
+	if (!result){
+		png_image_free(&image);
+	}
+	return result;
+}
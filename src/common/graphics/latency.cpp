@@ -0,0 +1,190 @@
+#include "latency.h"
+
+#include "event/event.h"
+
+#include <SDL.h>
+#include <GL/glew.h>
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+	// Most frames in flight low latency mode is asked to allow, and how
+	// many fences are kept waiting to be seen finished otherwise
+	const uint32_t MAX_FENCES = 8;
+	// A fence wait gives up after this, a lost context shouldn't hang the loop
+	const GLuint64 FENCE_TIMEOUT_NS = 100 * 1000 * 1000;
+	const uint32_t NO_INPUT = 0xFFFFFFFF;
+
+	struct latency_ring{
+		uint32_t values[LATENCY_SAMPLES];
+		uint32_t count;
+		uint32_t next;
+
+		void push(uint32_t v){
+			values[next] = v;
+			next = (next + 1) % LATENCY_SAMPLES;
+			count += count < LATENCY_SAMPLES;
+		}
+	};
+
+	struct frame_fence{
+		GLsync sync;
+		// Oldest input of the frame, NO_INPUT for none
+		uint32_t input;
+	};
+
+	struct latency_state{
+		uint64_t frame;
+		// Oldest input consumed since the last swap
+		uint32_t oldest;
+
+		latency_ring to_swap;
+		latency_ring to_gpu;
+
+		bool fences;
+		frame_fence pending[MAX_FENCES];
+		uint32_t pending_count;
+
+		bool low_latency;
+		uint32_t max_in_flight;
+		late_sample_function late_fn;
+		void* late_user;
+	};
+
+	latency_state* state = nullptr;
+
+	latency_state& get_state(void){
+		if (state == nullptr){
+			state = new latency_state;
+			memset(state, 0, sizeof(latency_state));
+			state->oldest = NO_INPUT;
+			state->max_in_flight = 1;
+		}
+		return *state;
+	}
+
+	latency_percentiles_t percentiles(const latency_ring& ring){
+		latency_percentiles_t result = {0, 0, 0, 0, 0};
+		if (ring.count == 0){
+			return result;
+		}
+
+		uint32_t sorted[LATENCY_SAMPLES];
+		memcpy(sorted, ring.values, ring.count * sizeof(uint32_t));
+		std::sort(sorted, sorted + ring.count);
+
+		result.samples = ring.count;
+		result.p50 = sorted[(ring.count - 1) * 50 / 100];
+		result.p90 = sorted[(ring.count - 1) * 90 / 100];
+		result.p99 = sorted[(ring.count - 1) * 99 / 100];
+		result.max = sorted[ring.count - 1];
+		return result;
+	}
+
+	// Retires the oldest fence, waiting for it when asked to
+	bool retire(latency_state& s, bool wait){
+		if (s.pending_count == 0){
+			return false;
+		}
+
+		frame_fence& oldest = s.pending[0];
+		GLenum status = glClientWaitSync(oldest.sync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? FENCE_TIMEOUT_NS : 0);
+		if (status == GL_TIMEOUT_EXPIRED && !wait){
+			return false;
+		}
+
+		if ((status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) && oldest.input != NO_INPUT){
+			s.to_gpu.push(SDL_GetTicks() - oldest.input);
+		}
+		glDeleteSync(oldest.sync);
+
+		--s.pending_count;
+		memmove(s.pending, s.pending + 1, s.pending_count * sizeof(frame_fence));
+		return true;
+	}
+}
+
+namespace render{ namespace latency{
+	void set_low_latency(bool enable, uint32_t max_frames_in_flight){
+		latency_state& s = get_state();
+		s.low_latency = enable;
+		s.max_in_flight = std::max<uint32_t>(1, std::min(max_frames_in_flight, MAX_FENCES));
+	}
+	void set_late_sample(late_sample_function fn, void* user){
+		latency_state& s = get_state();
+		s.late_fn = fn;
+		s.late_user = user;
+	}
+	void set_gpu_fences(bool enable){
+		get_state().fences = enable;
+	}
+
+	latency_stats_t stats(void){
+		latency_state& s = get_state();
+
+		latency_stats_t result;
+		result.to_swap = percentiles(s.to_swap);
+		result.to_gpu = percentiles(s.to_gpu);
+		result.frames = s.frame;
+		return result;
+	}
+	void reset(void){
+		latency_state& s = get_state();
+		s.to_swap.count = s.to_swap.next = 0;
+		s.to_gpu.count = s.to_gpu.next = 0;
+	}
+
+	uint64_t frame(void){
+		return get_state().frame;
+	}
+
+	void input(uint32_t timestamp){
+		latency_state& s = get_state();
+		// A replayed log carries the timestamps of the session it came from
+		if (event::replaying()){
+			return;
+		}
+		s.oldest = std::min(s.oldest, timestamp);
+	}
+
+	void before_render(void){
+		latency_state& s = get_state();
+		if (!s.low_latency){
+			return;
+		}
+		// Only refreshes what SDL_GetMouseState and SDL_GetKeyboardState report, the
+		// events themselves stay queued for the game's next poll
+		SDL_PumpEvents();
+		if (s.late_fn){
+			s.late_fn(s.late_user);
+		}
+	}
+
+	void swapped(void){
+		latency_state& s = get_state();
+		if (s.oldest != NO_INPUT){
+			s.to_swap.push(SDL_GetTicks() - s.oldest);
+		}
+
+		if (s.fences || s.low_latency){
+			// Out of room, the oldest is waited for rather than dropped
+			if (s.pending_count == MAX_FENCES){
+				retire(s, true);
+			}
+			s.pending[s.pending_count++] = {glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), s.oldest};
+
+			while (retire(s, false)){}
+			if (s.low_latency){
+				while (s.pending_count >= s.max_in_flight && retire(s, true)){}
+			}
+		}
+		else{
+			while (retire(s, true)){}
+		}
+
+		s.oldest = NO_INPUT;
+		++s.frame;
+	}
+}}
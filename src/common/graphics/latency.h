@@ -0,0 +1,56 @@
+#pragma once
+
+#include <inttypes.h>
+
+#define LATENCY_SAMPLES 1024
+
+// Milliseconds over the last LATENCY_SAMPLES frames that consumed input
+struct latency_percentiles_t{
+	uint32_t samples;
+	uint32_t p50, p90, p99, max;
+};
+struct latency_stats_t{
+	// From the SDL timestamp of a frame's oldest input to its swap returning
+	latency_percentiles_t to_swap;
+	// To the GPU finishing the frame, when fences are on
+	latency_percentiles_t to_gpu;
+	// Frames swapped so far
+	uint64_t frames;
+};
+
+// Called right before the render buffer is drawn, after SDL was pumped once more.
+// Read input with SDL_GetMouseState and friends, polling here would take events from the game
+typedef void (*late_sample_function)(void* user);
+
+/**
+ * Input to photon latency, as far as the library can see it. The pump
+ * stamps every keyboard and mouse event with the frame consuming it, and
+ * end_render measures from each frame's oldest input to the swap, and with
+ * fences on, to the GPU finishing the frame as seen on a later frame.
+ *
+ * Low latency mode keeps the CPU from queueing frames ahead of the GPU:
+ * end_render waits until fewer than max_frames_in_flight swapped frames
+ * are unfinished, so with 1 the next poll only happens once the GPU has
+ * caught up and input is as fresh as it can be. render::buffer::render
+ * also pumps SDL once more and calls the late sample function, which can
+ * read the device state and still push glyphs (a cursor, say) before the
+ * buffer is drawn. Queued events, edges and the frame batch are left for
+ * the game's next poll.
+ **/
+namespace render{ namespace latency{
+	void set_low_latency(bool enable, uint32_t max_frames_in_flight);
+	void set_late_sample(late_sample_function fn, void* user);
+	// Frame completion fences, needed for to_gpu and low latency mode
+	void set_gpu_fences(bool enable);
+
+	latency_stats_t stats(void);
+	void reset(void);
+
+	// The frame end_render will swap next
+	uint64_t frame(void);
+
+	// Called by the pump, end_render and the render buffer
+	void input(uint32_t timestamp);
+	void before_render(void);
+	void swapped(void);
+}}
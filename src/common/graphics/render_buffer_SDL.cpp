@@ -1,5 +1,6 @@
 #include "render_buffer.h"
 #include "renderer.h"
+#include "latency.h"
 
 #include "shader.h"
 #include "texture.h"
@@ -186,6 +187,9 @@ namespace render{ namespace buffer {
 		render_buffer->_clip_rect[0] = {0, 0, width, height};
 	}
 	void render(void){
+		// Low latency mode takes input here, as late as it can be and still be drawn
+		latency::before_render();
+
 		float ortho[4][4] = {
 			{ 2, 0, 0, 0},
 			{ 0,-2, 0, 0},
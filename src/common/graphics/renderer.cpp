@@ -1,5 +1,8 @@
 #include "renderer.h"
 #include "image.h"
+#include "latency.h"
+#include "io/prefetch.h"
+#include "task/parallel.h"
 
 #include <SDL.h>
 #include <GL/glew.h>
@@ -21,12 +24,18 @@ namespace {
 
 namespace render{
 	void initialize(int window_width, int window_height, const char* window_title, bool resizable){
+		// Last run's assets start loading while the window and context come up
+		io::prefetch::begin(PREFETCH_MANIFEST);
+
 		image_initialize();
+		// Decode workers are up before the first batch load
+		task::initialize();
 
 		if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0){
 			printf("SDL failed to initialize!\n");
 			return;
 		}
+		io::prefetch::mark("sdl");
 
 		renderer = new (buffer_renderer) SDL_Renderer();
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
@@ -43,6 +52,7 @@ namespace render{
 	    uint32_t flags = SDL_WINDOW_OPENGL| (resizable * SDL_WINDOW_RESIZABLE);
 
 	    /** SDL_Window **/renderer->window = SDL_CreateWindow(window_title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, window_width, window_height, flags);
+	    io::prefetch::mark("window");
 
 	    /** SDL_GLContext **/ renderer->glcontext = SDL_GL_CreateContext(renderer->window);
 	    // Initialize GL
@@ -52,6 +62,7 @@ namespace render{
 	    	shutdown();
 	    	return;
 	    }
+	    io::prefetch::mark("gl context");
 	    glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -62,6 +73,7 @@ namespace render{
 		SDL_GL_DeleteContext(renderer->glcontext);
 		SDL_DestroyWindow(renderer->window);
 		SDL_Quit();
+		task::shutdown();
 
 		renderer = nullptr;
 	}
@@ -85,6 +97,9 @@ namespace render{
 	}
 	void end_render(void){
 		SDL_GL_SwapWindow(renderer->window);
+		latency::swapped();
+		// Startup ends with the first frame, afterwards this does nothing
+		io::prefetch::finish();
 	}
 	void clear(void){
 		glClear(GL_COLOR_BUFFER_BIT);
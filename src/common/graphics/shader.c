@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "memory/handle.h"
 
 #include <GL/glew.h>
 #include <stdio.h>
@@ -25,6 +26,10 @@ static void check_link_errors(uint32_t prog_id, const char* type_name){
 	}
 }
 
+static GLint uniform(uint32_t prog, const char* name){
+	return glGetUniformLocation((GLuint)handle_get(HANDLE_SHADER, prog), name);
+}
+
 uint32_t shader_create_program(void* vsource, void* fsource, void* gsource, int32_t vlen, int32_t flen, int32_t glen){
 	uint32_t ret = 0;
 
@@ -78,36 +83,47 @@ uint32_t shader_create_program(void* vsource, void* fsource, void* gsource, int3
 			glDetachShader(ret, gid);
 			glDeleteShader(gid);
 		}
+
+		uint32_t id = ret;
+		ret = handle_alloc(HANDLE_SHADER, id, (uint64_t)vlen + flen + glen);
+		if (ret == 0){
+			printf("shader: handle pool full (%u programs)\n", handle_stats(HANDLE_SHADER).capacity);
+			glDeleteProgram(id);
+		}
 	}
 
 	return ret;
 }
 void shader_destroy_program(uint32_t prog){
-	glDeleteProgram(prog);
+	GLuint id = (GLuint)handle_get(HANDLE_SHADER, prog);
+	if (id){
+		glDeleteProgram(id);
+		handle_free(HANDLE_SHADER, prog);
+	}
 }
 
 void shader_use_program(uint32_t prog){
-	glUseProgram(prog);
+	glUseProgram((GLuint)handle_get(HANDLE_SHADER, prog));
 }
 
 void shader_set_bool(uint32_t prog, const char* name, const int value){
-	glUniform1i(glGetUniformLocation(prog, name), value);
+	glUniform1i(uniform(prog, name), value);
 }
 void shader_set_int(uint32_t prog, const char* name, const int32_t value){
-	glUniform1i(glGetUniformLocation(prog, name), value);
+	glUniform1i(uniform(prog, name), value);
 }
 void shader_set_float(uint32_t prog, const char* name, const float value){
-	glUniform1f(glGetUniformLocation(prog, name), value);
+	glUniform1f(uniform(prog, name), value);
 }
 
 void shader_set_vec2(uint32_t prog, const char* name, const float x, const float y){
-	glUniform2f(glGetUniformLocation(prog, name), x, y);
+	glUniform2f(uniform(prog, name), x, y);
 }
 void shader_set_vec3(uint32_t prog, const char* name, const float x, const float y, const float z){
-	glUniform3f(glGetUniformLocation(prog, name), x, y, z);
+	glUniform3f(uniform(prog, name), x, y, z);
 }
 void shader_set_vec4(uint32_t prog, const char* name, const float x, const float y, const float z, const float w){
-	glUniform4f(glGetUniformLocation(prog, name), x, y, z, w);
+	glUniform4f(uniform(prog, name), x, y, z, w);
 }
 
 void shader_set_vec2v(uint32_t prog, const char* name, const float* value){
@@ -121,11 +137,11 @@ void shader_set_vec4v(uint32_t prog, const char* name, const float* value){
 }
 
 void shader_set_mat2(uint32_t prog, const char* name, const float* value){
-	glUniformMatrix2fv(glGetUniformLocation(prog, name), 1, GL_FALSE, value);
+	glUniformMatrix2fv(uniform(prog, name), 1, GL_FALSE, value);
 }
 void shader_set_mat3(uint32_t prog, const char* name, const float* value){
-	glUniformMatrix3fv(glGetUniformLocation(prog, name), 1, GL_FALSE, value);
+	glUniformMatrix3fv(uniform(prog, name), 1, GL_FALSE, value);
 }
 void shader_set_mat4(uint32_t prog, const char* name, const float* value){
-	glUniformMatrix4fv(glGetUniformLocation(prog, name), 1, GL_FALSE, value);
+	glUniformMatrix4fv(uniform(prog, name), 1, GL_FALSE, value);
 }
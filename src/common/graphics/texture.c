@@ -1,97 +1,290 @@
 #include "texture.h"
 #include "image.h"
+#include "memory/handle.h"
 
 #include <GL/glew.h>
+#include <stdio.h>
 
 typedef struct {
-	uint32_t width, height;
+	uint32_t width, height, layers;
+	uint32_t target;
 	uint32_t format_internal, format_image;
 
 	uint32_t wrap_s, wrap_t;
 	uint32_t filter_min, filter_mag;
+	uint32_t mipmaps;
 } tex_info_t;
 
+static const uint32_t gl_wrap[] = {GL_REPEAT, GL_CLAMP_TO_EDGE, GL_MIRRORED_REPEAT};
+
+// Indexed by image_format_t
+static const uint32_t gl_format[] = {GL_RGBA, GL_RGB, GL_RED};
+static const uint32_t format_bytes[] = {4, 3, 1};
+
+static image_format_t format_from_bpp(int bpp){
+	return bpp == 1 ? IMAGE_FORMAT_R8 : (bpp == 3 ? IMAGE_FORMAT_RGB8 : IMAGE_FORMAT_RGBA8);
+}
+// Rows may be padded or be a window into a larger image, GL needs to know how to step between them.
+// The alignment is the largest power of two the stride allows, the row length only has to be given
+// when the stride is a whole number of pixels; otherwise the padding is left to the alignment
+static void begin_unpack(image_format_t format, uint32_t width, uint32_t stride){
+	uint32_t bytes = format_bytes[format];
+	if (stride == 0){
+		stride = width * bytes;
+	}
+	int32_t alignment = (stride % 8 == 0) ? 8 : (stride % 4 == 0) ? 4 : (stride % 2 == 0) ? 2 : 1;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, stride % bytes == 0 ? stride / bytes : 0);
+}
+static void end_unpack(void){
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+static uint32_t gl_filter(uint8_t filter){
+	return filter == TEXTURE_FILTER_LINEAR ? GL_LINEAR : GL_NEAREST;
+}
+static uint32_t gl_min_filter(const texture_options_t *opt){
+	static const uint32_t mip_filter[2][2] = {
+		{GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST_MIPMAP_LINEAR},
+		{GL_LINEAR_MIPMAP_NEAREST, GL_LINEAR_MIPMAP_LINEAR}
+	};
+	if (!opt->mipmaps){
+		return gl_filter(opt->filter_min);
+	}
+	return mip_filter[opt->filter_min == TEXTURE_FILTER_LINEAR][opt->filter_mip == TEXTURE_FILTER_LINEAR];
+}
+
 static tex_info_t default_texture_data(uint32_t *id){
 	glGenTextures(1, id);
 	tex_info_t ret = {
 		.width = 0,
 		.height = 0,
+		.layers = 1,
+		.target = GL_TEXTURE_2D,
 		.format_internal = GL_RGB,
-		.format_image = GL_RGB,
+		.format_image = GL_RGBA,
 		.wrap_s = GL_REPEAT,
 		.wrap_t = GL_REPEAT,
 		.filter_min = GL_NEAREST,
-		.filter_mag = GL_NEAREST
+		.filter_mag = GL_NEAREST,
+		.mipmaps = 0
 	};
 
 	return ret;
 }
+static void apply_options(tex_info_t *info, const texture_options_t *opt){
+	// Images are always decoded to 4 bytes per pixel, alpha only decides what is kept
+	info->format_internal = opt->alpha ? GL_RGBA : GL_RGB;
+	info->format_image = GL_RGBA;
 
-uint32_t texture_create(void *tex_data, uint32_t tex_len){
-	uint32_t ret = 0;
+	info->wrap_s = gl_wrap[opt->wrap_s % 3];
+	info->wrap_t = gl_wrap[opt->wrap_t % 3];
+	info->filter_min = gl_min_filter(opt);
+	info->filter_mag = gl_filter(opt->filter_mag);
+	info->mipmaps = opt->mipmaps;
+}
+// GL names are handed out counting up from 1, the top bit is free to remember the target
+#define TEXTURE_ARRAY_BIT ((uintptr_t)0x80000000u)
 
-	tex_info_t info = default_texture_data(&ret);
+// Hands the GL texture over to the handle pool, deleting it if the pool is full
+static uint32_t store_texture(uint32_t id, const tex_info_t *info, uint32_t bpp){
+	uint64_t bytes = (uint64_t)info->width * info->height * info->layers * bpp;
+	// A full mip chain adds a third on top of the base level
+	bytes += info->mipmaps ? bytes / 3 : 0;
 
-	uint32_t img = image_load_lump(tex_data, tex_len);
+	uintptr_t value = id | (info->target == GL_TEXTURE_2D_ARRAY ? TEXTURE_ARRAY_BIT : 0);
+	uint32_t ret = handle_alloc(HANDLE_TEXTURE, value, bytes);
+	if (ret == 0){
+		printf("texture: handle pool full (%u textures)\n", handle_stats(HANDLE_TEXTURE).capacity);
+		glDeleteTextures(1, &id);
+	}
+	return ret;
+}
+static uint32_t get_texture(uint32_t tex){
+	return (uint32_t)(handle_get(HANDLE_TEXTURE, tex) & ~TEXTURE_ARRAY_BIT);
+}
+static uint32_t get_target(uint32_t tex){
+	return (handle_get(HANDLE_TEXTURE, tex) & TEXTURE_ARRAY_BIT) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+}
+static void apply_parameters(const tex_info_t *info){
+	glTexParameteri(info->target, GL_TEXTURE_WRAP_S, info->wrap_s);
+	glTexParameteri(info->target, GL_TEXTURE_WRAP_T, info->wrap_t);
+	glTexParameteri(info->target, GL_TEXTURE_MIN_FILTER, info->filter_min);
+	glTexParameteri(info->target, GL_TEXTURE_MAG_FILTER, info->filter_mag);
+
+	if (info->mipmaps){
+		glGenerateMipmap(info->target);
+	}
+}
 
-	image_data_t data = image_data(img);
+texture_options_t texture_default_options(void){
+	texture_options_t ret = {
+		.wrap_s = TEXTURE_WRAP_REPEAT,
+		.wrap_t = TEXTURE_WRAP_REPEAT,
+		.filter_min = TEXTURE_FILTER_NEAREST,
+		.filter_mag = TEXTURE_FILTER_NEAREST,
+		.filter_mip = TEXTURE_FILTER_NEAREST,
+		.mipmaps = 0,
+		.alpha = 0
+	};
+	return ret;
+}
 
-	info.width = data.width;
-	info.height = data.height;
+uint32_t texture_create_pixels(const void *pixels, uint32_t width, uint32_t height, image_format_t format, uint32_t stride, const texture_options_t *opt){
+	uint32_t ret = 0;
 
-	unsigned char* image = data.data;
+	tex_info_t info = default_texture_data(&ret);
+	apply_options(&info, opt);
+
+	info.width = width;
+	info.height = height;
+	info.format_image = gl_format[format];
+	if (format == IMAGE_FORMAT_R8){
+		info.format_internal = GL_R8;
+	}
 
-	glBindTexture(GL_TEXTURE_2D, ret);
-	glTexImage2D(GL_TEXTURE_2D,
+	glBindTexture(info.target, ret);
+	begin_unpack(format, width, stride);
+	glTexImage2D(info.target,
 		0, info.format_internal, info.width, info.height,
-		0, info.format_image, GL_UNSIGNED_BYTE, image);
+		0, info.format_image, GL_UNSIGNED_BYTE, pixels);
+	end_unpack();
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, info.wrap_s);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, info.wrap_t);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, info.filter_min);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, info.filter_mag);
+	apply_parameters(&info);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindTexture(info.target, 0);
+
+	return store_texture(ret, &info, format_bytes[format]);
+}
+uint32_t texture_create_image(image_data_t data, const texture_options_t *opt){
+	return texture_create_pixels(data.data, data.width, data.height, format_from_bpp(data.bpp), data.pitch, opt);
+}
+uint32_t texture_create_ex(void *tex_data, uint32_t tex_len, const texture_options_t *opt){
+	uint32_t img = image_load_lump(tex_data, tex_len);
+	if (img == 0){
+		return 0;
+	}
+
+	uint32_t ret = texture_create_image(image_data(img), opt);
 
 	image_free(img);
 
 	return ret;
 }
+uint32_t texture_create(void *tex_data, uint32_t tex_len){
+	texture_options_t opt = texture_default_options();
+	return texture_create_ex(tex_data, tex_len, &opt);
+}
 uint32_t texture_create_alpha(void *tex_data, uint32_t tex_len){
+	texture_options_t opt = texture_default_options();
+	opt.alpha = 1;
+	return texture_create_ex(tex_data, tex_len, &opt);
+}
+
+uint32_t texture_create_array(void **tex_data, uint32_t *tex_len, uint32_t layers, const texture_options_t *opt){
 	uint32_t ret = 0;
+	if (layers == 0){
+		return ret;
+	}
 
 	tex_info_t info = default_texture_data(&ret);
-	info.format_internal = GL_RGBA;
-	info.format_image = GL_RGBA;
+	apply_options(&info, opt);
+	info.target = GL_TEXTURE_2D_ARRAY;
+	info.layers = layers;
 
-	uint32_t img = image_load_lump(tex_data, tex_len);
-	image_data_t data = image_data(img);
+	glBindTexture(info.target, ret);
+	for (uint32_t i = 0; i < layers; ++i){
+		uint32_t img = image_load_lump(tex_data[i], tex_len[i]);
+		if (img == 0){
+			printf("texture_create_array: layer %u failed to decode\n", i);
+			glBindTexture(info.target, 0);
+			glDeleteTextures(1, &ret);
+			return 0;
+		}
+		image_data_t data = image_data(img);
 
-	info.width = data.width;
-	info.height = data.height;
+		// First layer decides the dimensions of the whole array
+		if (i == 0){
+			info.width = data.width;
+			info.height = data.height;
 
-	unsigned char* image = data.data;
+			glTexImage3D(info.target,
+				0, info.format_internal, info.width, info.height, info.layers,
+				0, info.format_image, GL_UNSIGNED_BYTE, NULL);
+		}
 
-	glBindTexture(GL_TEXTURE_2D, ret);
-	glTexImage2D(GL_TEXTURE_2D,
-		0, info.format_internal, info.width, info.height,
-		0, info.format_image, GL_UNSIGNED_BYTE, image);
+		if ((uint32_t)data.width == info.width && (uint32_t)data.height == info.height){
+			begin_unpack(IMAGE_FORMAT_RGBA8, info.width, data.pitch);
+			glTexSubImage3D(info.target,
+				0, 0, 0, i, info.width, info.height, 1,
+				info.format_image, GL_UNSIGNED_BYTE, data.data);
+			end_unpack();
+		}
+		else{
+			printf("texture_create_array: layer %u is %dx%d, expected %ux%u\n", i, data.width, data.height, info.width, info.height);
+		}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, info.wrap_s);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, info.wrap_t);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, info.filter_min);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, info.filter_mag);
+		image_free(img);
+	}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-	image_free(img);
+	apply_parameters(&info);
 
-	return ret;
+	glBindTexture(info.target, 0);
+
+	return store_texture(ret, &info, 4);
+}
+
+void texture_update(uint32_t tex, int32_t x, int32_t y, uint32_t width, uint32_t height, const void *pixels, image_format_t format, uint32_t stride){
+	int32_t filter_min = 0;
+	uint32_t target = get_target(tex);
+
+	glBindTexture(target, get_texture(tex));
+	begin_unpack(format, width, stride);
+	if (target == GL_TEXTURE_2D_ARRAY){
+		glTexSubImage3D(target, 0, x, y, 0, width, height, 1, gl_format[format], GL_UNSIGNED_BYTE, pixels);
+	}
+	else{
+		glTexSubImage2D(target, 0, x, y, width, height, gl_format[format], GL_UNSIGNED_BYTE, pixels);
+	}
+	end_unpack();
+
+	glGetTexParameteriv(target, GL_TEXTURE_MIN_FILTER, &filter_min);
+	if (filter_min != GL_NEAREST && filter_min != GL_LINEAR){
+		glGenerateMipmap(target);
+	}
+	glBindTexture(target, 0);
 }
 
 void texture_destroy(uint32_t tex){
-	glDeleteTextures(1, &tex);
+	uint32_t id = get_texture(tex);
+	if (id){
+		glDeleteTextures(1, &id);
+		handle_free(HANDLE_TEXTURE, tex);
+	}
 }
 
 void texture_bind(const uint32_t tex){
-	glBindTexture(GL_TEXTURE_2D, tex);
-}
\ No newline at end of file
+	glBindTexture(GL_TEXTURE_2D, get_texture(tex));
+}
+void texture_bind_array(const uint32_t tex){
+	glBindTexture(GL_TEXTURE_2D_ARRAY, get_texture(tex));
+}
+
+uint32_t texture_create_sampler(const texture_options_t *opt){
+	uint32_t ret = 0;
+	glGenSamplers(1, &ret);
+
+	glSamplerParameteri(ret, GL_TEXTURE_WRAP_S, gl_wrap[opt->wrap_s % 3]);
+	glSamplerParameteri(ret, GL_TEXTURE_WRAP_T, gl_wrap[opt->wrap_t % 3]);
+	glSamplerParameteri(ret, GL_TEXTURE_MIN_FILTER, gl_min_filter(opt));
+	glSamplerParameteri(ret, GL_TEXTURE_MAG_FILTER, gl_filter(opt->filter_mag));
+
+	return ret;
+}
+void texture_destroy_sampler(uint32_t sampler){
+	glDeleteSamplers(1, &sampler);
+}
+void texture_bind_sampler(uint32_t unit, uint32_t sampler){
+	glBindSampler(unit, sampler);
+}
@@ -2,19 +2,63 @@
 #define H_TEXTURE_H
 
 #include <inttypes.h>
+#include "image.h"
+
+// Wrap/filter modes are mapped onto GL values inside texture.c so users
+// of the API don't need the GL headers
+typedef enum {
+	TEXTURE_WRAP_REPEAT = 0,
+	TEXTURE_WRAP_CLAMP,
+	TEXTURE_WRAP_MIRROR
+} texture_wrap_t;
+
+typedef enum {
+	TEXTURE_FILTER_NEAREST = 0,
+	TEXTURE_FILTER_LINEAR
+} texture_filter_t;
+
+typedef struct {
+	uint8_t wrap_s, wrap_t;
+	uint8_t filter_min, filter_mag;
+	// Filter between mip levels, only used when mipmaps are generated
+	uint8_t filter_mip;
+	uint8_t mipmaps;
+	// Upload as RGBA rather than RGB
+	uint8_t alpha;
+} texture_options_t;
 
 #ifdef __cplusplus
-#define EXTERN extern "C" 
+#define EXTERN extern "C"
 #else
 #define EXTERN
 #endif
 
+// Repeat, nearest filtering, no mipmaps, RGB
+EXTERN texture_options_t texture_default_options(void);
+
 EXTERN uint32_t texture_create(void *tex_data, uint32_t tex_len);
 EXTERN uint32_t texture_create_alpha(void *tex_data, uint32_t tex_len);
+EXTERN uint32_t texture_create_ex(void *tex_data, uint32_t tex_len, const texture_options_t *opt);
+// Uploads already decoded pixels, nothing is copied on the CPU side.
+// stride is the bytes per source row, 0 for tightly packed rows
+EXTERN uint32_t texture_create_image(image_data_t data, const texture_options_t *opt);
+EXTERN uint32_t texture_create_pixels(const void *pixels, uint32_t width, uint32_t height, image_format_t format, uint32_t stride, const texture_options_t *opt);
+// Every layer must decode to the same dimensions as the first, mismatched layers are left empty.
+// Returns 0 if any layer fails to decode
+EXTERN uint32_t texture_create_array(void **tex_data, uint32_t *tex_len, uint32_t layers, const texture_options_t *opt);
+
+// Replaces a sub rectangle of mip level 0 (layer 0 of an array), mipmaps are regenerated if the texture uses them
+EXTERN void texture_update(uint32_t tex, int32_t x, int32_t y, uint32_t width, uint32_t height, const void *pixels, image_format_t format, uint32_t stride);
 
 EXTERN void texture_destroy(uint32_t tex);
 
 EXTERN void texture_bind(const uint32_t tex);
+EXTERN void texture_bind_array(const uint32_t tex);
+
+// Sampler objects override the sampling state of whatever texture is bound to the unit
+EXTERN uint32_t texture_create_sampler(const texture_options_t *opt);
+EXTERN void texture_destroy_sampler(uint32_t sampler);
+EXTERN void texture_bind_sampler(uint32_t unit, uint32_t sampler);
 
 #undef EXTERN
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,243 @@
+#include "appender.h"
+#include "file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct file_appender_t{
+	int      fd;
+	uint8_t* ring;
+	uint64_t capacity;
+	uint64_t mask;
+	appender_options_t options;
+
+	// Monotonic byte positions, masked into the ring on use.
+	// reserve >= commit >= tail, and reserve - tail <= capacity
+	std::atomic<uint64_t> reserve;
+	std::atomic<uint64_t> commit;
+	std::atomic<uint64_t> tail;
+
+	// End of the file, only touched by the flush thread
+	uint64_t offset;
+	std::atomic<bool> failed;
+
+	std::mutex lock;
+	std::condition_variable wake;
+	// Set by anyone who needs a flush before the interval is up
+	bool requested;
+	bool stopping;
+	std::thread flusher;
+
+	// Signalled when tail or commit moves, for writers waiting on room or
+	// their turn to publish and for appender_flush
+	std::condition_variable progress;
+	std::atomic<uint32_t> waiters;
+};
+
+namespace {
+	const uint32_t TURN_SPINS = 64;
+
+	uint64_t round_pow2(uint64_t v){
+		uint64_t result = 1;
+		while (result < v){
+			result <<= 1;
+		}
+		return result;
+	}
+
+	// Writes [tail, commit) out, in two pieces when it wraps
+	bool drain(file_appender_t* a){
+		const uint64_t commit = a->commit.load(std::memory_order_acquire);
+		const uint64_t tail = a->tail.load(std::memory_order_relaxed);
+		if (commit == tail){
+			return false;
+		}
+
+		const uint64_t start = tail & a->mask;
+		const uint64_t bytes = commit - tail;
+		const uint64_t first = bytes < a->capacity - start ? bytes : a->capacity - start;
+
+		bool ok = io::file::write_fully(a->fd, a->ring + start, first, a->offset);
+		ok = ok && io::file::write_fully(a->fd, a->ring, bytes - first, a->offset + first);
+		if (!ok){
+			a->failed.store(true, std::memory_order_relaxed);
+		}
+		a->offset += bytes;
+
+		// Hands the space back to the writers
+		a->tail.store(commit, std::memory_order_release);
+		return true;
+	}
+	// An interval of 0 only flushes on request
+	void flush_thread(file_appender_t* a){
+		const std::chrono::milliseconds interval(a->options.flush_ms);
+		auto woken = [a]{ return a->requested || a->stopping; };
+		std::unique_lock<std::mutex> guard(a->lock);
+		while (!a->stopping){
+			if (a->options.flush_ms == 0){
+				a->wake.wait(guard, woken);
+			}
+			else{
+				a->wake.wait_for(guard, interval, woken);
+			}
+			a->requested = false;
+
+			guard.unlock();
+			const bool wrote = drain(a);
+			if (wrote && a->options.durability == APPENDER_DURABLE_INTERVAL){
+				fdatasync(a->fd);
+			}
+			guard.lock();
+			if (wrote){
+				a->progress.notify_all();
+			}
+		}
+	}
+	void wake_flusher(file_appender_t* a){
+		std::lock_guard<std::mutex> guard(a->lock);
+		a->requested = true;
+		a->wake.notify_one();
+	}
+	// Sleeps until ready holds. When that depends on a flush, one is asked for
+	// on every wakeup, a flush can find nothing committed yet and write nothing
+	template <typename Pred>
+	void wait_for_progress(file_appender_t* a, bool flush, Pred ready){
+		std::unique_lock<std::mutex> guard(a->lock);
+		a->waiters.fetch_add(1);
+		while (!ready()){
+			if (flush){
+				a->requested = true;
+				a->wake.notify_one();
+			}
+			a->progress.wait(guard);
+		}
+		a->waiters.fetch_sub(1);
+	}
+}
+
+namespace io{ namespace file{
+	appender_options_t appender_default_options(void){
+		appender_options_t result = {0};
+		result.ring_bytes = APPENDER_DEFAULT_RING;
+		result.flush_ms = APPENDER_DEFAULT_FLUSH_MS;
+		result.durability = APPENDER_DURABLE_NONE;
+		return result;
+	}
+
+	file_appender_t* appender_open(const char* path, const appender_options_t* opt){
+		int fd = open(path, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0){
+			return nullptr;
+		}
+
+		file_appender_t* a = new file_appender_t;
+		a->fd = fd;
+		a->options = opt ? *opt : appender_default_options();
+		a->capacity = round_pow2(a->options.ring_bytes ? a->options.ring_bytes : APPENDER_DEFAULT_RING);
+		a->mask = a->capacity - 1;
+		a->ring = new uint8_t[a->capacity];
+		a->reserve.store(0);
+		a->commit.store(0);
+		a->tail.store(0);
+		a->offset = lseek(fd, 0, SEEK_END);
+		a->failed.store(false);
+		a->requested = false;
+		a->stopping = false;
+		a->waiters.store(0);
+
+		a->flusher = std::thread(flush_thread, a);
+		return a;
+	}
+	bool appender_close(file_appender_t* a){
+		if (a == nullptr){
+			return false;
+		}
+		{
+			std::lock_guard<std::mutex> guard(a->lock);
+			a->stopping = true;
+			a->wake.notify_one();
+		}
+		a->flusher.join();
+
+		drain(a);
+		if (a->options.durability != APPENDER_DURABLE_NONE){
+			fdatasync(a->fd);
+		}
+
+		bool ok = !a->failed.load();
+		ok = (close(a->fd) == 0) && ok;
+
+		delete[] a->ring;
+		delete a;
+		return ok;
+	}
+
+	bool appender_write(file_appender_t* a, const void* data, uint32_t bytes){
+		if (bytes == 0){
+			return true;
+		}
+		if (bytes > a->capacity){
+			return false;
+		}
+
+		uint64_t start = a->reserve.load(std::memory_order_relaxed);
+		for (;;){
+			if (start + bytes - a->tail.load(std::memory_order_acquire) > a->capacity){
+				// Full, only now is it worth paying for a wakeup
+				// Against the latest reservation, start may be far behind by the time this wakes
+				wait_for_progress(a, true, [a, bytes]{
+					return a->reserve.load(std::memory_order_relaxed) + bytes - a->tail.load(std::memory_order_acquire) <= a->capacity;
+				});
+				start = a->reserve.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (a->reserve.compare_exchange_weak(start, start + bytes, std::memory_order_relaxed)){
+				break;
+			}
+		}
+
+		const uint64_t offset = start & a->mask;
+		const uint64_t first = bytes < a->capacity - offset ? bytes : a->capacity - offset;
+		memcpy(a->ring + offset, data, first);
+		memcpy(a->ring, (const uint8_t*)data + first, bytes - first);
+
+		// Earlier reservations publish first so the flush thread only ever sees
+		// whole records. They are only a copy away, so spin a little before sleeping
+		for (uint32_t spins = 0; a->commit.load(std::memory_order_acquire) != start; ++spins){
+			if (spins == TURN_SPINS){
+				wait_for_progress(a, false, [a, start]{
+					return a->commit.load(std::memory_order_acquire) == start;
+				});
+				break;
+			}
+		}
+		a->commit.store(start + bytes, std::memory_order_seq_cst);
+		// Pairs with the increment in wait_for_progress, either the waiter sees
+		// the new commit or this sees the waiter
+		if (a->waiters.load(std::memory_order_seq_cst) > 0){
+			std::lock_guard<std::mutex> guard(a->lock);
+			a->progress.notify_all();
+		}
+
+		if (start + bytes - a->tail.load(std::memory_order_relaxed) > a->capacity / 2 &&
+			start - a->tail.load(std::memory_order_relaxed) <= a->capacity / 2){
+			wake_flusher(a);
+		}
+		return true;
+	}
+	void appender_flush(file_appender_t* a){
+		const uint64_t target = a->commit.load(std::memory_order_acquire);
+		if (a->tail.load(std::memory_order_acquire) < target){
+			wait_for_progress(a, true, [a, target]{
+				return a->tail.load(std::memory_order_acquire) >= target;
+			});
+		}
+	}
+}}
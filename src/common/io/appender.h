@@ -0,0 +1,49 @@
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * Append-only file writer for logs and telemetry. The file stays open and
+ * writes are copied into an in-memory ring, which a background thread
+ * writes out every flush interval or whenever it fills up past half. With
+ * a flush interval of 0 it only writes on demand: past half, when the ring
+ * is full, on appender_flush and on close.
+ *
+ * Any thread may write. Space in the ring is reserved with a compare and
+ * swap and records become visible to the flush thread in reservation order,
+ * so records never interleave. A write only blocks when the ring is full,
+ * sleeping until the flush thread has made room.
+ **/
+enum appender_durability_t{
+	// Left to the page cache
+	APPENDER_DURABLE_NONE = 0,
+	// fdatasync after every flush that wrote anything
+	APPENDER_DURABLE_INTERVAL,
+	// fdatasync once when closing
+	APPENDER_DURABLE_CLOSE,
+};
+
+struct appender_options_t{
+	// Rounded up to a power of two, a single write can't be larger
+	uint32_t ring_bytes;
+	uint32_t flush_ms;
+	uint8_t  durability;
+};
+
+#define APPENDER_DEFAULT_RING     (1024 * 1024)
+#define APPENDER_DEFAULT_FLUSH_MS 100
+
+struct file_appender_t;
+
+namespace io{ namespace file{
+	appender_options_t appender_default_options(void);
+
+	// opt may be null for the defaults. Returns null if the file can't be opened
+	file_appender_t* appender_open (const char* path, const appender_options_t* opt);
+	// Writes what is left, syncs when asked to and frees the appender. False if any write failed
+	bool             appender_close(file_appender_t* appender);
+
+	bool             appender_write(file_appender_t* appender, const void* data, uint32_t bytes);
+	// Waits until everything written so far has reached the file
+	void             appender_flush(file_appender_t* appender);
+}}
@@ -0,0 +1,421 @@
+#include "async.h"
+#include "event/event.h"
+#include "event/event_queue.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef IO_HAVE_URING
+#include <liburing.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace {
+	// Blocking I/O threads for the fallback, these mostly sleep in the kernel
+	const uint32_t ASYNC_THREADS = 4;
+	const uint32_t COLLECT_CHUNK = 32;
+	// A ring entry's length is 32 bits, larger requests go through in pieces
+	const uint64_t URING_ENTRY_MAX = 1u << 30;
+
+	struct async_slot{
+		async_request_t request;
+		uint32_t id;
+		int      fd;
+		int64_t  result;
+		// Bytes moved so far, io_uring can come back short
+		uint64_t done;
+	};
+
+	struct async_state{
+		std::vector<async_slot> slots;
+		std::vector<uint32_t> free_slots;
+		std::vector<uint32_t> queued;
+		uint32_t next_id;
+		uint32_t in_flight;
+
+		// Finished slots waiting to be collected
+		std::mutex lock;
+		std::vector<uint32_t> done;
+
+		// Thread pool fallback
+		std::condition_variable work_ready;
+		std::deque<uint32_t> work;
+		std::vector<std::thread> workers;
+		bool stopping;
+
+		bool uring;
+#ifdef IO_HAVE_URING
+		struct io_uring ring;
+		// Submitted to the ring and not reaped yet
+		uint32_t in_ring;
+		// Signalled by the kernel for every completion, ends a blocking wait
+		int event_fd;
+#endif
+	};
+
+	async_state* state = nullptr;
+
+	int open_for(const async_request_t& request){
+		if (request.op == ASYNC_READ){
+			return open(request.path, O_RDONLY);
+		}
+		return open(request.path, O_WRONLY | O_CREAT, 0644);
+	}
+	void finish(uint32_t index, int64_t result){
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			state->slots[index].result = result;
+			state->done.push_back(index);
+		}
+		// From a pool thread this ends the main thread's wait
+		event::queue::wake();
+	}
+
+	// Runs a whole request with blocking calls, only stopping short at end of file
+	int64_t transfer(const async_request_t& request){
+		int fd = open_for(request);
+		if (fd < 0){
+			return -errno;
+		}
+
+		uint8_t* data = (uint8_t*)request.data;
+		int64_t done = 0;
+		while ((uint64_t)done < request.bytes){
+			ssize_t n = (request.op == ASYNC_READ)
+				? pread(fd, data + done, request.bytes - done, request.offset + done)
+				: pwrite(fd, data + done, request.bytes - done, request.offset + done);
+			if (n < 0 && errno == EINTR){
+				continue;
+			}
+			if (n < 0){
+				done = -errno;
+				break;
+			}
+			if (n == 0){
+				break;
+			}
+			done += n;
+		}
+		close(fd);
+		return done;
+	}
+	void worker(void){
+		for (;;){
+			uint32_t index;
+			{
+				std::unique_lock<std::mutex> guard(state->lock);
+				state->work_ready.wait(guard, []{ return state->stopping || !state->work.empty(); });
+				// Whatever was submitted still runs before the threads exit
+				if (state->work.empty()){
+					return;
+				}
+				index = state->work.front();
+				state->work.pop_front();
+			}
+			finish(index, transfer(state->slots[index].request));
+		}
+	}
+
+#ifdef IO_HAVE_URING
+	// Queues what is left of a request as one ring entry. The ring is as deep
+	// as the slot table and a slot has one entry at a time, so one is always free
+	void prep_uring(uint32_t index){
+		async_slot& slot = state->slots[index];
+		const async_request_t& request = slot.request;
+
+		struct io_uring_sqe* sqe = io_uring_get_sqe(&state->ring);
+		uint8_t* data = (uint8_t*)request.data + slot.done;
+		const uint64_t left = request.bytes - slot.done;
+		const unsigned bytes = (unsigned)(left < URING_ENTRY_MAX ? left : URING_ENTRY_MAX);
+		if (request.op == ASYNC_READ){
+			io_uring_prep_read(sqe, slot.fd, data, bytes, request.offset + slot.done);
+		}
+		else{
+			io_uring_prep_write(sqe, slot.fd, data, bytes, request.offset + slot.done);
+		}
+		io_uring_sqe_set_data(sqe, (void*)(uintptr_t)index);
+		++state->in_ring;
+	}
+	void complete_uring(uint32_t index, int64_t result){
+		close(state->slots[index].fd);
+		state->slots[index].fd = -1;
+		finish(index, result);
+	}
+
+	// Files are opened here rather than through the ring, opens are cheap next
+	// to the transfers and this keeps every request a single ring entry
+	void submit_uring(void){
+		uint32_t count = 0;
+		for (uint32_t index : state->queued){
+			async_slot& slot = state->slots[index];
+			slot.fd = open_for(slot.request);
+			if (slot.fd < 0){
+				finish(index, -errno);
+				continue;
+			}
+			prep_uring(index);
+			++count;
+		}
+		if (count){
+			io_uring_submit(&state->ring);
+		}
+	}
+	void reap_uring(bool wait){
+		struct io_uring_cqe* cqe;
+		uint32_t resubmitted = 0;
+
+		// Drained before looking at the ring, a completion after this signals again
+		if (state->event_fd >= 0){
+			uint64_t signalled;
+			ssize_t n = read(state->event_fd, &signalled, sizeof(signalled));
+			(void)n;
+		}
+		while (state->in_ring > 0){
+			int ret = wait ? io_uring_wait_cqe(&state->ring, &cqe) : io_uring_peek_cqe(&state->ring, &cqe);
+			if (ret != 0){
+				break;
+			}
+
+			uint32_t index = (uint32_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+			int32_t res = cqe->res;
+			io_uring_cqe_seen(&state->ring, cqe);
+			--state->in_ring;
+
+			// Same as transfer: short transfers carry on from where they
+			// stopped, only end of file or an error ends a request early
+			async_slot& slot = state->slots[index];
+			if (res == -EINTR || res == -EAGAIN){
+				res = 0;
+			}
+			else if (res < 0){
+				complete_uring(index, res);
+				continue;
+			}
+			else if (res == 0){
+				complete_uring(index, slot.done);
+				continue;
+			}
+			slot.done += res;
+
+			if (slot.done < slot.request.bytes){
+				prep_uring(index);
+				++resubmitted;
+			}
+			else{
+				complete_uring(index, slot.done);
+			}
+
+			// Waiting for the rest needs them in the kernel first
+			if (wait && resubmitted){
+				io_uring_submit(&state->ring);
+				resubmitted = 0;
+			}
+		}
+		if (resubmitted){
+			io_uring_submit(&state->ring);
+		}
+	}
+#endif
+
+	// Moves up to max finished requests out of the done list and frees their slots
+	uint32_t collect(async_completion_t* completions, async_callback* fns, uint32_t max){
+#ifdef IO_HAVE_URING
+		if (state->uring){
+			reap_uring(false);
+		}
+#endif
+		std::lock_guard<std::mutex> guard(state->lock);
+
+		uint32_t count = state->done.size() < max ? state->done.size() : max;
+		for (uint32_t i = 0; i < count; ++i){
+			uint32_t index = state->done[i];
+			const async_slot& slot = state->slots[index];
+
+			async_completion_t& c = completions[i];
+			c.id = slot.id;
+			c.op = slot.request.op;
+			c.data = slot.request.data;
+			c.user = slot.request.user;
+			c.result = slot.result;
+			if (fns){
+				fns[i] = slot.request.fn;
+			}
+
+			state->free_slots.push_back(index);
+		}
+		state->done.erase(state->done.begin(), state->done.begin() + count);
+		state->in_flight -= count;
+
+		return count;
+	}
+}
+
+namespace io{ namespace async{
+	bool initialize(uint32_t queue_depth){
+		if (state){
+			return true;
+		}
+		if (queue_depth == 0){
+			queue_depth = ASYNC_DEFAULT_DEPTH;
+		}
+
+		state = new async_state;
+		state->slots.resize(queue_depth);
+		state->free_slots.reserve(queue_depth);
+		for (uint32_t i = queue_depth; i > 0; --i){
+			state->free_slots.push_back(i - 1);
+		}
+		state->next_id = 0;
+		state->in_flight = 0;
+		state->stopping = false;
+		state->uring = false;
+
+#ifdef IO_HAVE_URING
+		state->in_ring = 0;
+		state->event_fd = -1;
+		state->uring = io_uring_queue_init(queue_depth, &state->ring, 0) == 0;
+		if (state->uring){
+			state->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (state->event_fd >= 0 && io_uring_register_eventfd(&state->ring, state->event_fd) == 0){
+				event::queue::wake_on(state->event_fd);
+			}
+			else if (state->event_fd >= 0){
+				close(state->event_fd);
+				state->event_fd = -1;
+			}
+		}
+#endif
+		if (!state->uring){
+			for (uint32_t i = 0; i < ASYNC_THREADS; ++i){
+				state->workers.emplace_back(worker);
+			}
+		}
+		return true;
+	}
+	void shutdown(void){
+		if (state == nullptr){
+			return;
+		}
+
+		// Submitted requests are still writing into caller buffers, so they
+		// have to finish, their completions are dropped
+#ifdef IO_HAVE_URING
+		if (state->uring){
+			reap_uring(true);
+			if (state->event_fd >= 0){
+				event::queue::stop_waking_on(state->event_fd);
+			}
+			io_uring_queue_exit(&state->ring);
+			if (state->event_fd >= 0){
+				close(state->event_fd);
+			}
+		}
+#endif
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			state->stopping = true;
+		}
+		state->work_ready.notify_all();
+		for (std::thread& t : state->workers){
+			t.join();
+		}
+
+		delete state;
+		state = nullptr;
+	}
+
+	uint32_t queue(const async_request_t& request){
+		if (state == nullptr || state->free_slots.empty()){
+			return 0;
+		}
+
+		uint32_t index = state->free_slots.back();
+		state->free_slots.pop_back();
+
+		async_slot& slot = state->slots[index];
+		slot.request = request;
+		slot.fd = -1;
+		slot.result = 0;
+		slot.done = 0;
+		slot.id = ++state->next_id;
+		if (slot.id == 0){
+			slot.id = ++state->next_id;
+		}
+
+		state->queued.push_back(index);
+		return slot.id;
+	}
+	uint32_t submit(void){
+		if (state == nullptr || state->queued.empty()){
+			return 0;
+		}
+
+		uint32_t count = state->queued.size();
+		state->in_flight += count;
+#ifdef IO_HAVE_URING
+		if (state->uring){
+			submit_uring();
+		}
+#endif
+		if (!state->uring){
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+				state->work.insert(state->work.end(), state->queued.begin(), state->queued.end());
+			}
+			state->work_ready.notify_all();
+		}
+		state->queued.clear();
+
+		return count;
+	}
+
+	uint32_t poll(async_completion_t* completions, uint32_t max){
+		return state ? collect(completions, nullptr, max) : 0;
+	}
+	uint32_t dispatch(void){
+		if (state == nullptr){
+			return 0;
+		}
+
+		async_completion_t completions[COLLECT_CHUNK];
+		async_callback fns[COLLECT_CHUNK];
+
+		// Delivered outside the lock, callbacks are free to queue more work
+		uint32_t total = 0, count = 0;
+		do{
+			count = collect(completions, fns, COLLECT_CHUNK);
+			for (uint32_t i = 0; i < count; ++i){
+				if (fns[i]){
+					fns[i](completions + i);
+				}
+				else{
+					event::call_event_handler(EVENT_FILE_COMPLETE, completions + i);
+				}
+			}
+			total += count;
+		} while (count == COLLECT_CHUNK);
+
+		return total;
+	}
+
+	uint32_t pending(void){
+		return state ? state->in_flight : 0;
+	}
+	bool ready(void){
+		if (state == nullptr){
+			return false;
+		}
+		std::lock_guard<std::mutex> guard(state->lock);
+		return !state->done.empty();
+	}
+	bool using_uring(void){
+		return state && state->uring;
+	}
+}}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * Asynchronous file reads and writes. Requests are queued, then sent off
+ * together by submit, which is one system call with io_uring. Where io_uring
+ * isn't compiled in or the kernel refuses it, a small pool of threads does
+ * blocking pread/pwrite instead, with the same behaviour.
+ *
+ * Finished requests are collected either by poll, into an array, or by
+ * dispatch, which hands each one to its callback, or when it has none, to
+ * the event handler for EVENT_FILE_COMPLETE. event::poll_events and friends
+ * call dispatch, so completions arrive in the main loop next to SDL events,
+ * and a completion ends a blocking event::wait_events.
+ *
+ * Buffers belong to the caller and must stay valid until the request completes.
+ * request.path is only copied as a pointer, so it must stay valid until the
+ * file is opened, which is during submit with io_uring and whenever a pool
+ * thread picks the request up otherwise. Keeping it until completion is safe.
+ **/
+enum async_op_t{
+	ASYNC_READ = 0,
+	ASYNC_WRITE,
+};
+
+struct async_completion_t{
+	uint32_t id;
+	uint32_t op;
+	void*    data;
+	void*    user;
+	// Bytes transferred, or a negative errno
+	int64_t  result;
+};
+
+typedef void (*async_callback)(const async_completion_t* completion);
+
+struct async_request_t{
+	uint32_t       op;
+	const char*    path;
+	void*          data;
+	uint64_t       offset;
+	uint64_t       bytes;
+	// Null to deliver the completion as an EVENT_FILE_COMPLETE event
+	async_callback fn;
+	void*          user;
+};
+
+#define ASYNC_DEFAULT_DEPTH 64
+
+namespace io{ namespace async{
+	// queue_depth bounds the requests queued or in flight at once, 0 for the default
+	bool     initialize(uint32_t queue_depth);
+	// Waits for submitted requests to finish and drops their completions
+	void     shutdown(void);
+
+	// Returns an id for the request, 0 if the queue is full
+	uint32_t queue(const async_request_t& request);
+	// Starts everything queued since the last submit, returns how many
+	uint32_t submit(void);
+
+	// Fills completions with up to max finished requests, without calling anything
+	uint32_t poll(async_completion_t* completions, uint32_t max);
+	// Delivers every finished request to its callback or as an event
+	uint32_t dispatch(void);
+
+	// Requests submitted that haven't been collected yet
+	uint32_t pending(void);
+	// Something finished and can be collected. Safe to ask while requests complete
+	bool     ready(void);
+	// True when completions come from io_uring rather than the thread pool
+	bool     using_uring(void);
+}}
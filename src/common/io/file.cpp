@@ -1,55 +1,136 @@
 #include "file.h"
+#include "watch.h"
+#include "prefetch.h"
 
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 #include <stdio.h>
 
 namespace io{ namespace file{
+	int64_t read_fully(int fd, void* store, uint64_t bytes, uint64_t offset){
+		uint8_t* dest = (uint8_t*)store;
+		uint64_t done = 0;
+		while (done < bytes){
+			ssize_t n = pread(fd, dest + done, bytes - done, offset + done);
+			if (n < 0 && errno == EINTR){
+				continue;
+			}
+			if (n < 0){
+				return -1;
+			}
+			if (n == 0){
+				break;
+			}
+			done += n;
+		}
+		return done;
+	}
+	bool write_fully(int fd, const void* data, uint64_t bytes, uint64_t offset){
+		const uint8_t* src = (const uint8_t*)data;
+		uint64_t done = 0;
+		while (done < bytes){
+			ssize_t n = pwrite(fd, src + done, bytes - done, offset + done);
+			if (n < 0 && errno == EINTR){
+				continue;
+			}
+			if (n <= 0){
+				return false;
+			}
+			done += n;
+		}
+		return true;
+	}
+
 	bool exists(const char* path){
+		file_info_t info;
+		watch_lookup_t cached = io::watch::lookup(path, info);
+		if (cached != WATCH_UNKNOWN){
+			return cached == WATCH_FOUND;
+		}
+
 		struct stat buf;
 		return (stat(path, &buf) == 0);
 	}
-	uint32_t size(const char* path){
+	uint64_t size(const char* path){
+		file_info_t info;
+		watch_lookup_t cached = io::watch::lookup(path, info);
+		if (cached != WATCH_UNKNOWN){
+			return cached == WATCH_FOUND ? info.size : 0;
+		}
+
+		return size_on_disk(path);
+	}
+	uint64_t size_on_disk(const char* path){
 		struct stat buf;
-		uint32_t sz = 0;
+		uint64_t sz = 0;
 
 		if (stat(path, &buf) != -1){
-			sz = (uint32_t)buf.st_size;
+			sz = (uint64_t)buf.st_size;
 		}
 		return sz;
 	}
-	bool write(const char* path, void* data, uint32_t bytes){
+	bool write(const char* path, void* data, uint64_t bytes){
 		if (bytes > 0){
 			FILE *file = fopen(path, "wb");
 			if (!file){
 				return false;
 			}
-			(void)fwrite(data, bytes, 1, file);
-			fclose(file);
+			bool ok = fwrite(data, bytes, 1, file) == 1;
+			ok = (fclose(file) == 0) && ok;
+			return ok;
 		}
 		return true;
 	}
-	bool append(const char* path, void* data, uint32_t bytes){
+	bool append(const char* path, void* data, uint64_t bytes){
 		if (bytes > 0){
 			FILE *file = fopen(path, "ab");
 			if (!file){
 				return false;
 			}
-			(void)fwrite(data, bytes, 1, file);
-			fclose(file);
+			bool ok = fwrite(data, bytes, 1, file) == 1;
+			ok = (fclose(file) == 0) && ok;
+			return ok;
 		}
 		return true;
 	}
-	uint32_t read(const char* path, void* store, uint32_t bytes){
-		FILE *file = fopen(path, "rb");
-		uint32_t sz = 0;
+	uint64_t read(const char* path, void* store, uint64_t bytes){
+		io::prefetch::touch(path);
+		int fd = open(path, O_RDONLY);
+		if (fd < 0){
+			return 0;
+		}
 
-		if (file){
-			sz = size(path);
+		// Sized from the open descriptor, the watch cache may not have seen a write yet
+		struct stat buf;
+		uint64_t sz = 0;
+		if (fstat(fd, &buf) == 0){
+			sz = (uint64_t)buf.st_size;
 			sz = sz > bytes ? bytes : sz;
-			sz = (uint32_t)fread(store, 1, sz, file);
-			fclose(file);
 		}
+		int64_t done = read_fully(fd, store, sz, 0);
+		close(fd);
+		return done < 0 ? 0 : (uint64_t)done;
+	}
 
-		return sz;
+	uint64_t read_at(const char* path, void* store, uint64_t bytes, uint64_t offset){
+		io::prefetch::touch(path);
+		int fd = open(path, O_RDONLY);
+		if (fd < 0){
+			return 0;
+		}
+		int64_t sz = read_fully(fd, store, bytes, offset);
+		close(fd);
+		return sz < 0 ? 0 : (uint64_t)sz;
+	}
+	bool write_at(const char* path, void* data, uint64_t bytes, uint64_t offset){
+		int fd = open(path, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0){
+			return false;
+		}
+		bool ok = write_fully(fd, data, bytes, offset);
+		ok = (close(fd) == 0) && ok;
+		return ok;
 	}
 }}
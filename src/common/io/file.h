@@ -2,13 +2,114 @@
 
 #include <inttypes.h>
 
+// Read-only window onto file contents owned by someone else (a mapping or an embedded array)
+struct file_view_t{
+	const void* data;
+	uint64_t    bytes;
+};
+
+// How a mapped file is going to be read, passed on to the kernel as an madvise hint
+enum file_access_t{
+	FILE_ACCESS_NORMAL = 0,
+	// Read front to back once, aggressive readahead and pages dropped behind
+	FILE_ACCESS_SEQUENTIAL,
+	// Will be needed soon, start reading all of it in now
+	FILE_ACCESS_WILLNEED,
+};
+
+// Streams a file through one fixed buffer, so files of any size are read in constant memory
+struct file_reader_t{
+	int      fd;
+	uint64_t size;
+	// File offset just past the buffered bytes
+	uint64_t offset;
+	uint8_t* buffer;
+	uint32_t capacity;
+	// Unread bytes are buffer[begin, end)
+	uint32_t begin;
+	uint32_t end;
+	bool     owns_buffer;
+};
+// Collects writes in a fixed buffer and writes it out at the current offset when full
+struct file_writer_t{
+	int      fd;
+	uint64_t offset;
+	uint8_t* buffer;
+	uint32_t capacity;
+	uint32_t used;
+	bool     owns_buffer;
+	// Sticky, any failed write fails the close
+	bool     failed;
+};
+
+#define FILE_STREAM_DEFAULT_BUFFER (256 * 1024)
+
+// One match from a find iteration. path is only valid until the next step
+struct file_match_t{
+	const char* path;
+	uint32_t    path_bytes;
+	// Index of the first pattern that matched
+	uint32_t    pattern;
+};
+// Return false to stop the walk
+typedef bool (*find_function)(void* user, const file_match_t& match);
+
+struct file_find_t;
+
 namespace io{ namespace file{
+	// Answered by io::watch under watched directories, so may be a frame behind the disk.
+	// read and read_at always go to the file itself
 	bool     exists(const char* path);
-	uint32_t size  (const char* path);
-	bool     write (const char* path, void* data, uint32_t bytes);
-	bool     append(const char* path, void* data, uint32_t bytes);
-	uint32_t read  (const char* path, void* store, uint32_t bytes);
+	uint64_t size  (const char* path);
+	// Always asks the filesystem, for sizing a buffer that is about to be read into
+	uint64_t size_on_disk(const char* path);
+	bool     write (const char* path, void* data, uint64_t bytes);
+	bool     append(const char* path, void* data, uint64_t bytes);
+	uint64_t read  (const char* path, void* store, uint64_t bytes);
+
+	// Reads or writes in place at an offset, writing creates the file if needed
+	uint64_t read_at (const char* path, void* store, uint64_t bytes, uint64_t offset);
+	bool     write_at(const char* path, void* data, uint64_t bytes, uint64_t offset);
+
+	// For code already holding a descriptor, pread/pwrite until done, end of file or an error.
+	// read_fully returns the bytes read or -1
+	int64_t  read_fully (int fd, void* store, uint64_t bytes, uint64_t offset);
+	bool     write_fully(int fd, const void* data, uint64_t bytes, uint64_t offset);
+
+	// buffer may be null to allocate buffer_bytes (0 for the default) internally
+	bool     reader_open (file_reader_t& reader, const char* path, void* buffer, uint32_t buffer_bytes);
+	void     reader_close(file_reader_t& reader);
+	// The next buffer-sized piece of the file, valid until the next call on the reader.
+	// False at the end of the file
+	bool     reader_next (file_reader_t& reader, file_view_t& chunk);
+	// Copies out up to bytes, large reads go straight into store
+	uint64_t reader_read (file_reader_t& reader, void* store, uint64_t bytes);
+	void     reader_seek (file_reader_t& reader, uint64_t offset);
+	uint64_t reader_tell (const file_reader_t& reader);
+
+	// Starts writing at the end of the file when append is set, otherwise truncates it
+	bool     writer_open (file_writer_t& writer, const char* path, void* buffer, uint32_t buffer_bytes, bool append);
+	// Returns false if anything written through the writer failed
+	bool     writer_close(file_writer_t& writer);
+	bool     writer_write(file_writer_t& writer, const void* data, uint64_t bytes);
+	bool     writer_flush(file_writer_t& writer);
+
+	// Maps the whole file read-only. An empty file maps to an empty view.
+	// Every successful map must be paired with an unmap of the same view
+	bool     map  (const char* path, file_view_t& view, file_access_t access);
+	void     unmap(file_view_t& view);
 
 	uint32_t find(const char* root, const char* ext, void* store, uint32_t store_bytes, uint32_t& store_bytes_used);
 	uint32_t find_recursive(const char* root, const char* ext, void* store, uint32_t store_bytes, uint32_t& store_bytes_used);
+
+	// Streams matching files in directory order, without a result buffer. A pattern
+	// containing any of *?[ is a glob on the file name (fnmatch), anything else an
+	// ending such as ".png", so one walk can look for several kinds of file at once.
+	// Links to directories are followed unless they lead back to a directory already
+	// being walked. find_begin returns null if root can't be opened
+	file_find_t* find_begin(const char* root, const char** patterns, uint32_t pattern_count, bool recursive);
+	bool         find_next (file_find_t* it, file_match_t& match);
+	void         find_end  (file_find_t* it);
+	// Calls fn for every match, returns how many were visited
+	uint32_t     find_each (const char* root, const char** patterns, uint32_t pattern_count, bool recursive, find_function fn, void* user);
 }}
@@ -1,10 +1,23 @@
 #include "file.h"
-
+#include "watch.h"
+#include "task/parallel.h"
 
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <unistd.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
 static bool str_ends_with(const char* str, const uint32_t str_len, const char* end, const uint32_t end_len){
 	bool result = false;
 
@@ -27,14 +40,415 @@ static DIR* open_directory(const char* path){
 	DIR *dr = opendir(path);
 	return dr;
 }
-static DIR* open_directory_if(int condition, const char* path){
-	return condition ? open_directory(path) : 0;
+
+// find answers from the watch cache when it can, storing paths the same way
+struct find_cached{
+	const char* root;
+	uint32_t    root_len;
+	const char* ext;
+	uint32_t    ext_len;
+	uint8_t*    store;
+	uint32_t    store_bytes;
+	uint32_t    used;
+	uint32_t    result;
+};
+static void find_cached_entry(void* user, const char* name, const file_info_t& info){
+	find_cached* f = (find_cached*)user;
+	const uint32_t name_len = strlen(name);
+	if (info.directory || !str_ends_with(name, name_len, f->ext, f->ext_len)){
+		return;
+	}
+
+	++f->result;
+	int can_copy = f->store_bytes > (f->used + 2 + f->root_len + name_len);
+	f->used += str_copy_if(can_copy, f->store + f->used, f->root, f->root_len);
+	f->used += str_copy_if(can_copy, f->store + f->used, "/", 1);
+	f->used += str_copy_if(can_copy, f->store + f->used, name, name_len);
+	f->used += str_copy_if(can_copy, f->store + f->used, "\0", 1);
+}
+
+/**
+ * find_recursive walks with up to every worker. Each directory is a task.
+ * The calling thread opens directories on its own until there are enough
+ * pending to go round, then starts one worker per pending directory, capped
+ * at the hardware threads. Workers take tasks off the back of their own
+ * queue, depth first so few directories are open at once, or steal from the
+ * front of someone else's, and sleep while every queue is empty.
+ * Directories are opened relative to their parent's descriptor, so neither
+ * depth nor path length is limited, and a parent stays open until all of
+ * its subdirectories have been opened. Links to directories are followed,
+ * a directory that is already one of its own ancestors is not scanned again.
+ **/
+namespace {
+	const uint32_t DENTS_BUFFER_BYTES = 32 * 1024;
+
+	struct walk_dir{
+		int fd;
+		dev_t dev;
+		ino_t ino;
+		// Outlives the descriptor, loops are found by looking up the chain
+		walk_dir* parent;
+		// The scan plus children not opened yet, the descriptor closes at 0
+		std::atomic<uint32_t> opens;
+		// One while open plus one per child directory
+		std::atomic<uint32_t> refs;
+	};
+	struct walk_task{
+		// Null for the root, which is opened relative to the working directory
+		walk_dir*   parent;
+		std::string path;
+		uint32_t    name_offset;
+	};
+	struct walk_queue{
+		std::mutex lock;
+		std::deque<walk_task> tasks;
+	};
+	struct walk_state{
+		const char* ext;
+		uint32_t    ext_len;
+		uint32_t    workers;
+
+		walk_queue* queues;
+		// Tasks queued or being scanned, the walk is over at 0
+		std::atomic<uint32_t> outstanding;
+		// Tasks waiting in a queue
+		std::atomic<uint32_t> queued;
+
+		// Idle workers wait here for a task or the end of the walk
+		std::mutex idle_lock;
+		std::condition_variable idle;
+		std::atomic<uint32_t> sleeping;
+		// Matches, one list per worker
+		std::vector<std::vector<std::string>> found;
+	};
+
+	enum entry_kind{
+		ENTRY_SKIP = 0,
+		ENTRY_FILE,
+		ENTRY_DIR,
+	};
+	// Only stats when the directory listing didn't say what the entry is
+	entry_kind classify(int dir_fd, const struct dirent64* de){
+		const char* name = de->d_name;
+		entry_kind kind = (de->d_type == DT_DIR) ? ENTRY_DIR : ENTRY_FILE;
+		if (de->d_type == DT_UNKNOWN || de->d_type == DT_LNK){
+			struct stat buf;
+			if (fstatat(dir_fd, name, &buf, 0) != 0){
+				return ENTRY_SKIP;
+			}
+			// Follows links, the walk catches the ones that loop
+			if (S_ISDIR(buf.st_mode)){
+				kind = ENTRY_DIR;
+			}
+		}
+		// Skips ".", ".." and hidden directories
+		if (kind == ENTRY_DIR && name[0] == '.'){
+			kind = ENTRY_SKIP;
+		}
+		return kind;
+	}
+
+	void release(walk_dir* dir){
+		while (dir && dir->refs.fetch_sub(1) == 1){
+			walk_dir* parent = dir->parent;
+			delete dir;
+			dir = parent;
+		}
+	}
+	void release_fd(walk_dir* dir){
+		if (dir && dir->opens.fetch_sub(1) == 1){
+			close(dir->fd);
+			release(dir);
+		}
+	}
+	bool is_ancestor(const walk_dir* dir, const struct stat& buf){
+		for (; dir; dir = dir->parent){
+			if (dir->dev == buf.st_dev && dir->ino == buf.st_ino){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool take(walk_state& state, uint32_t self, walk_task& task){
+		for (uint32_t i = 0; i < state.workers; ++i){
+			walk_queue& queue = state.queues[(self + i) % state.workers];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (queue.tasks.empty()){
+				continue;
+			}
+			if (i == 0){
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			state.queued.fetch_sub(1);
+			return true;
+		}
+		return false;
+	}
+
+	void scan(walk_state& state, uint32_t self, walk_task& task, char* dents){
+		int fd = openat(task.parent ? task.parent->fd : AT_FDCWD, task.path.c_str() + task.name_offset, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		struct stat buf;
+		if (fd >= 0 && (fstat(fd, &buf) != 0 || is_ancestor(task.parent, buf))){
+			close(fd);
+			fd = -1;
+		}
+		if (fd < 0){
+			release_fd(task.parent);
+			return;
+		}
+
+		walk_dir* dir = new walk_dir;
+		dir->fd = fd;
+		dir->dev = buf.st_dev;
+		dir->ino = buf.st_ino;
+		dir->parent = task.parent;
+		if (dir->parent){
+			dir->parent->refs.fetch_add(1);
+		}
+		release_fd(task.parent);
+		// The scan holds the descriptor open
+		dir->opens.store(1);
+		dir->refs.store(1);
+
+		walk_queue& queue = state.queues[self];
+		for (;;){
+			long bytes = syscall(SYS_getdents64, fd, dents, DENTS_BUFFER_BYTES);
+			if (bytes <= 0){
+				break;
+			}
+
+			for (long pos = 0; pos < bytes;){
+				const struct dirent64* de = (const struct dirent64*)(dents + pos);
+				pos += de->d_reclen;
+
+				const char* name = de->d_name;
+				const entry_kind kind = classify(fd, de);
+				if (kind == ENTRY_SKIP){
+					continue;
+				}
+
+				const uint32_t name_len = strlen(name);
+				if (kind == ENTRY_DIR){
+
+					walk_task child;
+					child.parent = dir;
+					child.path.reserve(task.path.size() + 1 + name_len);
+					child.path.append(task.path).append(1, '/').append(name, name_len);
+					child.name_offset = task.path.size() + 1;
+
+					dir->opens.fetch_add(1);
+					state.outstanding.fetch_add(1);
+
+					{
+						std::lock_guard<std::mutex> guard(queue.lock);
+						queue.tasks.push_back(std::move(child));
+					}
+					// Either a sleeper sees the task when it checks, or it is counted here
+					state.queued.fetch_add(1);
+					if (state.sleeping.load() > 0){
+						std::lock_guard<std::mutex> guard(state.idle_lock);
+						state.idle.notify_one();
+					}
+				}
+				else if (str_ends_with(name, name_len, state.ext, state.ext_len)){
+					std::string path;
+					path.reserve(task.path.size() + 1 + name_len);
+					path.append(task.path).append(1, '/').append(name, name_len);
+					state.found[self].push_back(std::move(path));
+				}
+			}
+		}
+		release_fd(dir);
+	}
+
+	void walk_worker(void* user, uint32_t self){
+		walk_state& state = *(walk_state*)user;
+
+		std::vector<uint64_t> dents(DENTS_BUFFER_BYTES / sizeof(uint64_t));
+		walk_task task;
+		for (;;){
+			if (take(state, self, task)){
+				scan(state, self, task, (char*)dents.data());
+				if (state.outstanding.fetch_sub(1) == 1){
+					std::lock_guard<std::mutex> guard(state.idle_lock);
+					state.idle.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> guard(state.idle_lock);
+			state.sleeping.fetch_add(1);
+			state.idle.wait(guard, [&state]{
+				return state.outstanding.load() == 0 || state.queued.load() > 0;
+			});
+			state.sleeping.fetch_sub(1);
+			if (state.outstanding.load() == 0){
+				return;
+			}
+		}
+	}
+}
+
+struct find_pattern{
+	std::string text;
+	bool glob;
+};
+struct find_level{
+	int fd;
+	dev_t dev;
+	ino_t ino;
+	uint32_t path_bytes;
+	long pos;
+	long bytes;
+};
+// Depth first with one open directory and one listing buffer per level.
+// Buffers stay allocated when a level is popped and the path grows in place,
+// so after the first few directories stepping through entries allocates nothing
+struct file_find_t{
+	std::vector<find_pattern> patterns;
+	bool recursive;
+
+	std::vector<find_level> stack;
+	std::vector<std::vector<uint64_t>> buffers;
+	std::string path;
+};
+
+namespace {
+	int match_pattern(const file_find_t* it, const char* name, uint32_t name_len){
+		for (uint32_t i = 0; i < it->patterns.size(); ++i){
+			const find_pattern& p = it->patterns[i];
+			if (p.glob ? fnmatch(p.text.c_str(), name, 0) == 0 : str_ends_with(name, name_len, p.text.c_str(), p.text.size())){
+				return i;
+			}
+		}
+		return -1;
+	}
+	bool push_level(file_find_t* it, int fd){
+		if (fd < 0){
+			return false;
+		}
+		// A linked directory that is already on the stack would loop
+		struct stat buf;
+		bool seen = fstat(fd, &buf) != 0;
+		for (uint32_t i = 0; !seen && i < it->stack.size(); ++i){
+			seen = it->stack[i].dev == buf.st_dev && it->stack[i].ino == buf.st_ino;
+		}
+		if (seen){
+			close(fd);
+			return false;
+		}
+
+		find_level level = {fd, buf.st_dev, buf.st_ino, (uint32_t)it->path.size(), 0, 0};
+		it->stack.push_back(level);
+		if (it->buffers.size() < it->stack.size()){
+			it->buffers.emplace_back(DENTS_BUFFER_BYTES / sizeof(uint64_t));
+		}
+		return true;
+	}
 }
 
 namespace io{ namespace file{
+	file_find_t* find_begin(const char* root, const char** patterns, uint32_t pattern_count, bool recursive){
+		file_find_t* it = new file_find_t;
+		it->recursive = recursive;
+		it->path = root;
+		for (uint32_t i = 0; i < pattern_count; ++i){
+			find_pattern p;
+			p.text = patterns[i];
+			p.glob = strpbrk(patterns[i], "*?[") != nullptr;
+			it->patterns.push_back(p);
+		}
+
+		if (!push_level(it, open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC))){
+			delete it;
+			return nullptr;
+		}
+		return it;
+	}
+	bool find_next(file_find_t* it, file_match_t& match){
+		while (!it->stack.empty()){
+			find_level& top = it->stack.back();
+			char* dents = (char*)it->buffers[it->stack.size() - 1].data();
+			if (top.pos >= top.bytes){
+				top.pos = 0;
+				top.bytes = syscall(SYS_getdents64, top.fd, dents, DENTS_BUFFER_BYTES);
+				if (top.bytes <= 0){
+					close(top.fd);
+					it->stack.pop_back();
+				}
+				continue;
+			}
+
+			const struct dirent64* de = (const struct dirent64*)(dents + top.pos);
+			top.pos += de->d_reclen;
+
+			const entry_kind kind = classify(top.fd, de);
+			if (kind == ENTRY_SKIP || (kind == ENTRY_DIR && !it->recursive)){
+				continue;
+			}
+
+			const uint32_t name_len = strlen(de->d_name);
+			it->path.resize(top.path_bytes);
+			it->path.append(1, '/').append(de->d_name, name_len);
+
+			if (kind == ENTRY_DIR){
+				push_level(it, openat(top.fd, de->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+				continue;
+			}
+
+			int pattern = match_pattern(it, de->d_name, name_len);
+			if (pattern >= 0){
+				match.path = it->path.c_str();
+				match.path_bytes = it->path.size();
+				match.pattern = pattern;
+				return true;
+			}
+		}
+		return false;
+	}
+	void find_end(file_find_t* it){
+		if (it == nullptr){
+			return;
+		}
+		for (const find_level& level : it->stack){
+			close(level.fd);
+		}
+		delete it;
+	}
+
+	uint32_t find_each(const char* root, const char** patterns, uint32_t pattern_count, bool recursive, find_function fn, void* user){
+		file_find_t* it = find_begin(root, patterns, pattern_count, recursive);
+		if (it == nullptr){
+			return 0;
+		}
+
+		uint32_t result = 0;
+		file_match_t match;
+		while (find_next(it, match)){
+			++result;
+			if (!fn(user, match)){
+				break;
+			}
+		}
+		find_end(it);
+		return result;
+	}
+
 	uint32_t find(const char* root_path, const char* ext, void* store, uint32_t store_bytes, uint32_t& store_bytes_used){
 		store_bytes_used = 0;
 
+		find_cached cached = {root_path, (uint32_t)strlen(root_path), ext, (uint32_t)strlen(ext), (uint8_t*)store, store_bytes, 0, 0};
+		if (io::watch::list(root_path, find_cached_entry, &cached)){
+			store_bytes_used = cached.used;
+			return cached.result;
+		}
+
 		struct dirent *de = 0;
 
 		DIR *dr = open_directory(root_path);
@@ -56,8 +470,7 @@ namespace io{ namespace file{
 				#endif
 				{
 					struct stat buf;
-					stat(de->d_name, &buf);
-					is_dir = S_ISDIR(buf.st_mode);
+					is_dir = fstatat(dirfd(dr), de->d_name, &buf, 0) == 0 && S_ISDIR(buf.st_mode);
 				}
 
 				if (!is_dir){
@@ -79,95 +492,65 @@ namespace io{ namespace file{
 					}
 				}
 			}
+			closedir(dr);
 		}
-		closedir(dr);
 
 		return result;
 	}
 	uint32_t find_recursive(const char* root_path, const char* ext, void* store, uint32_t store_bytes, uint32_t& store_bytes_used){
-		struct dirent* de = 0;
-
-		#define MAX_STACK_DEPTH (32)
-		int stack_end_of_dir_path[MAX_STACK_DEPTH];
-		DIR *open_dir[MAX_STACK_DEPTH] = {0};
-
-		int in_stack = 0;
+		walk_state state;
+		state.ext = ext;
+		state.ext_len = strlen(ext);
+		state.workers = task::worker_count();
+		state.queues = new walk_queue[state.workers];
+		state.found.resize(state.workers);
+		state.outstanding.store(1);
+		state.queued.store(1);
+		state.sleeping.store(0);
 
-		char full_path[1024] = {0};
-		uint32_t root_path_len = strlen(root_path);
-		uint32_t file_path_len = 0;
+		walk_task root;
+		root.parent = nullptr;
+		root.path = root_path;
+		root.name_offset = 0;
+		state.queues[0].tasks.push_back(root);
 
-		memcpy(full_path, root_path, root_path_len);
-		stack_end_of_dir_path[in_stack++] = root_path_len;
+		// Breadth first on this thread until every worker would have a directory,
+		// small trees never start a thread
+		{
+			std::vector<uint64_t> dents(DENTS_BUFFER_BYTES / sizeof(uint64_t));
+			std::deque<walk_task>& tasks = state.queues[0].tasks;
+			while (!tasks.empty() && tasks.size() < state.workers){
+				walk_task task = std::move(tasks.front());
+				tasks.pop_front();
+				state.queued.fetch_sub(1);
+				scan(state, 0, task, (char*)dents.data());
+				state.outstanding.fetch_sub(1);
+			}
+		}
+		const uint32_t pending = state.queued.load();
+		if (pending > 0){
+			state.workers = std::min(pending, state.workers);
+			task::parallel_for(state.workers, walk_worker, &state);
+		}
+		delete[] state.queues;
 
-		uint32_t result = 0;
-		const uint32_t ext_len = strlen(ext);
+		// Workers finish in any order, sorting makes the result the same every time
+		std::vector<std::string> found;
+		for (std::vector<std::string>& part : state.found){
+			found.insert(found.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+		}
+		std::sort(found.begin(), found.end());
 
+		// Everything is counted, paths are stored while they fit
+		store_bytes_used = 0;
 		uint8_t* store_head = (uint8_t*)store;
-
-		if ((open_dir[in_stack-1] = open_directory(full_path)) != 0){
-			while (in_stack > 0){
-				while ((de = readdir(open_dir[in_stack-1]))){
-					int cur_eos = stack_end_of_dir_path[in_stack-1];
-					// Ensure that the path ends with "\/0"
-					(void)str_copy(full_path + cur_eos, "/\0", 2);
-
-					// Mostly the same as file_find for a bit
-					int is_dir = 0;
-					#ifdef _DIRENT_HAVE_D_TYPE
-					if (de->d_type != DT_UNKNOWN && de->d_type != DT_LNK){
-						is_dir = (de->d_type == DT_DIR);
-					}else
-					#endif
-					{
-						struct stat buf;
-						stat(de->d_name, &buf);
-						is_dir = S_ISDIR(buf.st_mode);
-					}
-
-					file_path_len = strlen(de->d_name);
-					if (!is_dir){
-						// Test extension
-						if (str_ends_with(de->d_name, file_path_len, ext, ext_len)){
-							++result;
-							// Copy into head
-							// Can copy entire path
-							int can_copy = store_bytes > (store_bytes_used + 1 + cur_eos + file_path_len);
-							// Copy current full path
-							store_bytes_used += str_copy_if(can_copy, store_head + store_bytes_used, full_path, cur_eos + 1); // <path> + '/'
-							// Copy in file path
-							store_bytes_used += str_copy_if(can_copy, store_head + store_bytes_used, de->d_name, file_path_len);
-							// Copy in null-terminator
-							store_bytes_used += str_copy_if(can_copy, store_head + store_bytes_used, "\0", 1);
-						}
-					}
-					else{
-						// is a directory!
-						// Ignore directories beginning in '.'
-						int can_copy = (de->d_name[0] != '.');
-						// Push the name onto the full path
-						// Copy directory path after [cur_path]/
-						int path_added = cur_eos + 1;
-						path_added += str_copy_if(can_copy, full_path + path_added, de->d_name, file_path_len);
-						// Add null-terminator
-						path_added += str_copy_if(can_copy, full_path + path_added, "\0", 1);
-						stack_end_of_dir_path[in_stack] = path_added - 1; // Path len is sans nullterminator
-						// Try to open the directory
-						open_dir[in_stack] = open_directory_if(can_copy, full_path);
-						in_stack += (open_dir[in_stack] != 0);
-					}
-				}
-				// Close the open dir
-				closedir(open_dir[in_stack-1]);
-				open_dir[in_stack-1] = 0;
-				// Pop stack
-				--in_stack;
+		for (const std::string& path : found){
+			if (store_bytes_used + path.size() + 1 > store_bytes){
+				break;
 			}
-		}
-		if (open_dir[in_stack]){
-			closedir(open_dir[in_stack]);
+			store_bytes_used += str_copy(store_head + store_bytes_used, path.c_str(), path.size() + 1);
 		}
 
-		return result;
+		return found.size();
 	}
 }}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "file.h"
+#include "prefetch.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+	// Indexed by file_access_t
+	const int advice[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_WILLNEED};
+}
+
+namespace io{ namespace file{
+	bool map(const char* path, file_view_t& view, file_access_t access){
+		view.data = nullptr;
+		view.bytes = 0;
+
+		io::prefetch::touch(path);
+		int fd = open(path, O_RDONLY);
+		if (fd < 0){
+			return false;
+		}
+
+		struct stat buf;
+		void* base = MAP_FAILED;
+		bool ok = fstat(fd, &buf) == 0;
+		if (ok && buf.st_size > 0){
+			base = mmap(nullptr, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			ok = base != MAP_FAILED;
+		}
+		// The mapping keeps the file alive
+		close(fd);
+
+		if (ok && base != MAP_FAILED){
+			// Only a hint, the mapping is fine whether or not it's taken
+			(void)madvise(base, buf.st_size, advice[access]);
+
+			view.data = base;
+			view.bytes = buf.st_size;
+		}
+		return ok;
+	}
+	void unmap(file_view_t& view){
+		if (view.data){
+			munmap((void*)view.data, view.bytes);
+		}
+		view.data = nullptr;
+		view.bytes = 0;
+	}
+}}
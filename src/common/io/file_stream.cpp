@@ -0,0 +1,162 @@
+#include "file.h"
+#include "prefetch.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace {
+	uint8_t* take_buffer(void* buffer, uint32_t& buffer_bytes, bool& owns){
+		if (buffer_bytes == 0){
+			buffer_bytes = FILE_STREAM_DEFAULT_BUFFER;
+		}
+		owns = buffer == nullptr;
+		return owns ? new uint8_t[buffer_bytes] : (uint8_t*)buffer;
+	}
+	void release_buffer(uint8_t*& buffer, bool owns){
+		if (owns){
+			delete[] buffer;
+		}
+		buffer = nullptr;
+	}
+
+	bool fill(file_reader_t& reader){
+		int64_t n = io::file::read_fully(reader.fd, reader.buffer, reader.capacity, reader.offset);
+		reader.begin = 0;
+		reader.end = n > 0 ? (uint32_t)n : 0;
+		reader.offset += reader.end;
+		return reader.end > 0;
+	}
+}
+
+namespace io{ namespace file{
+	bool reader_open(file_reader_t& reader, const char* path, void* buffer, uint32_t buffer_bytes){
+		memset(&reader, 0, sizeof(reader));
+		io::prefetch::touch(path);
+		reader.fd = open(path, O_RDONLY);
+		if (reader.fd < 0){
+			return false;
+		}
+
+		struct stat buf;
+		if (fstat(reader.fd, &buf) != 0){
+			close(reader.fd);
+			reader.fd = -1;
+			return false;
+		}
+		reader.size = buf.st_size;
+		// Hint only, the reader goes front to back unless it's told to seek
+		(void)posix_fadvise(reader.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		reader.buffer = take_buffer(buffer, buffer_bytes, reader.owns_buffer);
+		reader.capacity = buffer_bytes;
+		return true;
+	}
+	void reader_close(file_reader_t& reader){
+		if (reader.fd >= 0){
+			close(reader.fd);
+		}
+		release_buffer(reader.buffer, reader.owns_buffer);
+		reader.fd = -1;
+	}
+
+	bool reader_next(file_reader_t& reader, file_view_t& chunk){
+		if (reader.begin == reader.end && !fill(reader)){
+			return false;
+		}
+		chunk.data = reader.buffer + reader.begin;
+		chunk.bytes = reader.end - reader.begin;
+		reader.begin = reader.end;
+		return true;
+	}
+	uint64_t reader_read(file_reader_t& reader, void* store, uint64_t bytes){
+		uint8_t* dest = (uint8_t*)store;
+		uint64_t done = 0;
+
+		while (done < bytes){
+			if (reader.begin < reader.end){
+				uint64_t n = reader.end - reader.begin;
+				n = n < bytes - done ? n : bytes - done;
+				memcpy(dest + done, reader.buffer + reader.begin, n);
+				reader.begin += n;
+				done += n;
+				continue;
+			}
+			// Nothing buffered, anything at least a buffer long skips the copy
+			if (bytes - done >= reader.capacity){
+				int64_t n = read_fully(reader.fd, dest + done, bytes - done, reader.offset);
+				if (n > 0){
+					reader.offset += n;
+					done += n;
+				}
+				break;
+			}
+			if (!fill(reader)){
+				break;
+			}
+		}
+		return done;
+	}
+	void reader_seek(file_reader_t& reader, uint64_t offset){
+		reader.offset = offset;
+		reader.begin = reader.end = 0;
+	}
+	uint64_t reader_tell(const file_reader_t& reader){
+		return reader.offset - (reader.end - reader.begin);
+	}
+
+	bool writer_open(file_writer_t& writer, const char* path, void* buffer, uint32_t buffer_bytes, bool append){
+		memset(&writer, 0, sizeof(writer));
+		writer.fd = open(path, O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0644);
+		if (writer.fd < 0){
+			return false;
+		}
+
+		struct stat buf;
+		if (append && fstat(writer.fd, &buf) == 0){
+			writer.offset = buf.st_size;
+		}
+
+		writer.buffer = take_buffer(buffer, buffer_bytes, writer.owns_buffer);
+		writer.capacity = buffer_bytes;
+		return true;
+	}
+	bool writer_close(file_writer_t& writer){
+		bool ok = writer_flush(writer);
+		if (writer.fd >= 0){
+			ok = (close(writer.fd) == 0) && ok;
+		}
+		release_buffer(writer.buffer, writer.owns_buffer);
+		writer.fd = -1;
+		return ok;
+	}
+
+	bool writer_write(file_writer_t& writer, const void* data, uint64_t bytes){
+		const uint8_t* src = (const uint8_t*)data;
+		if (bytes > writer.capacity - writer.used){
+			writer_flush(writer);
+			// Too big to be worth buffering, write it where it goes
+			if (bytes >= writer.capacity){
+				if (!write_fully(writer.fd, src, bytes, writer.offset)){
+					writer.failed = true;
+				}
+				writer.offset += bytes;
+				return !writer.failed;
+			}
+		}
+		memcpy(writer.buffer + writer.used, src, bytes);
+		writer.used += bytes;
+		return !writer.failed;
+	}
+	bool writer_flush(file_writer_t& writer){
+		if (writer.used > 0){
+			if (!write_fully(writer.fd, writer.buffer, writer.used, writer.offset)){
+				writer.failed = true;
+			}
+			writer.offset += writer.used;
+			writer.used = 0;
+		}
+		return !writer.failed;
+	}
+}}
@@ -0,0 +1,400 @@
+#include "pack.h"
+#include "prefetch.h"
+#include "resource/hash.h"
+#include "task/parallel.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef PACK_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+namespace {
+	struct mounted_pack{
+		std::string path;
+		const uint8_t* base;
+		uint64_t bytes;
+
+		const pack_header* header;
+		const pack_entry* entries;
+		const char* names;
+
+		// Where each entry's contents live, in the mapping or the arena.
+		// Null for entries that failed to decompress
+		std::vector<const uint8_t*> data;
+		uint8_t* arena;
+
+		pack_stats_t stats;
+	};
+
+	std::vector<mounted_pack>* mounts = nullptr;
+
+	const char* normalize(const char* path){
+		while (path[0] == '.' && path[1] == '/'){
+			path += 2;
+		}
+		return path;
+	}
+	uint64_t align(uint64_t offset, uint64_t alignment){
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Everything the index points at has to lie inside the mapping
+	bool validate(const uint8_t* base, uint64_t bytes){
+		if (bytes < sizeof(pack_header)){
+			return false;
+		}
+		const pack_header* header = (const pack_header*)base;
+		if (memcmp(header->magic, PACK_MAGIC, 4) != 0 || header->version != PACK_VERSION){
+			return false;
+		}
+		if (header->names_offset > header->index_offset || header->index_offset > bytes){
+			return false;
+		}
+		if ((uint64_t)header->count * sizeof(pack_entry) > bytes - header->index_offset){
+			return false;
+		}
+
+		const pack_entry* entries = (const pack_entry*)(base + header->index_offset);
+		const uint64_t names_bytes = header->index_offset - header->names_offset;
+		for (uint32_t i = 0; i < header->count; ++i){
+			const pack_entry& e = entries[i];
+			if (e.offset > header->names_offset || e.bytes > header->names_offset - e.offset){
+				return false;
+			}
+			if ((e.flags & ~PACK_ENTRY_LZ4) != 0){
+				return false;
+			}
+			// LZ4 works in ints, stored entries are used as they are
+			if ((e.flags & PACK_ENTRY_LZ4) ? (e.bytes > INT32_MAX || e.raw_bytes > INT32_MAX) : (e.raw_bytes != e.bytes)){
+				return false;
+			}
+			if ((uint64_t)e.name_offset + e.name_bytes > names_bytes){
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct decompress_job{
+		mounted_pack* pack;
+		// Entry indices, largest first so the big ones don't end up last on one thread
+		std::vector<uint32_t> entries;
+	};
+	void decompress_entry(void* user, uint32_t ndx){
+		decompress_job* job = (decompress_job*)user;
+		mounted_pack* pack = job->pack;
+
+		const uint32_t i = job->entries[ndx];
+		const pack_entry& e = pack->entries[i];
+		bool ok = false;
+#ifdef PACK_HAVE_LZ4
+		int raw = LZ4_decompress_safe((const char*)(pack->base + e.offset), (char*)pack->data[i], (int)e.bytes, (int)e.raw_bytes);
+		ok = (raw >= 0) && ((uint64_t)raw == e.raw_bytes);
+#endif
+		if (!ok){
+			printf("pack: could not decompress %.*s\n", (int)e.name_bytes, pack->names + e.name_offset);
+			pack->data[i] = nullptr;
+		}
+	}
+	void decompress(mounted_pack& pack){
+		pack_stats_t& stats = pack.stats;
+		const uint32_t count = pack.header->count;
+
+		decompress_job job;
+		job.pack = &pack;
+
+		pack.data.resize(count);
+		uint64_t arena_bytes = 0;
+		for (uint32_t i = 0; i < count; ++i){
+			const pack_entry& e = pack.entries[i];
+			pack.data[i] = pack.base + e.offset;
+
+			stats.stored_bytes += e.bytes;
+			stats.raw_bytes += e.raw_bytes;
+			if (e.flags & PACK_ENTRY_LZ4){
+				job.entries.push_back(i);
+				arena_bytes = align(arena_bytes, PACK_ALIGN) + e.raw_bytes;
+
+				++stats.compressed_files;
+				stats.compressed_stored_bytes += e.bytes;
+				stats.compressed_raw_bytes += e.raw_bytes;
+			}
+		}
+		stats.files = count;
+
+		pack.arena = nullptr;
+		if (job.entries.empty()){
+			return;
+		}
+
+		// One arena for everything keeps the decompressed files together and
+		// is a single allocation to free on unmount
+		pack.arena = new uint8_t[arena_bytes];
+		uint64_t offset = 0;
+		for (uint32_t i : job.entries){
+			offset = align(offset, PACK_ALIGN);
+			pack.data[i] = pack.arena + offset;
+			offset += pack.entries[i].raw_bytes;
+		}
+
+		std::sort(job.entries.begin(), job.entries.end(), [&pack](uint32_t a, uint32_t b){
+			return pack.entries[a].raw_bytes > pack.entries[b].raw_bytes;
+		});
+
+		auto start = std::chrono::steady_clock::now();
+		task::parallel_for(job.entries.size(), decompress_entry, &job);
+		stats.decompress_seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	}
+	void report(const mounted_pack& pack){
+		const pack_stats_t& stats = pack.stats;
+		const double kib = 1.0 / 1024.0;
+
+		printf("pack: %s, %u files, %.1f KiB stored, %.1f KiB raw\n",
+			pack.path.c_str(), stats.files, stats.stored_bytes * kib, stats.raw_bytes * kib);
+		if (stats.compressed_files){
+			const double mib_per_s = stats.decompress_seconds > 0 ? (stats.compressed_raw_bytes * kib * kib) / stats.decompress_seconds : 0;
+			printf("pack: %u compressed, %.1f KiB -> %.1f KiB in %.2f ms (%.1f MiB/s)\n",
+				stats.compressed_files, stats.compressed_stored_bytes * kib, stats.compressed_raw_bytes * kib,
+				stats.decompress_seconds * 1000.f, mib_per_s);
+		}
+	}
+
+	// Stores data compressed when that saves at least an eighth of it
+	bool compress_entry(const std::vector<uint8_t>& data, std::vector<uint8_t>& packed){
+#ifdef PACK_HAVE_LZ4
+		if (data.empty() || data.size() > INT32_MAX){
+			return false;
+		}
+		packed.resize(LZ4_compressBound((int)data.size()));
+		int bytes = LZ4_compress_HC((const char*)data.data(), (char*)packed.data(), (int)data.size(), (int)packed.size(), LZ4HC_CLEVEL_MAX);
+		if (bytes > 0 && (uint64_t)bytes < data.size() - data.size() / 8){
+			packed.resize(bytes);
+			return true;
+		}
+#endif
+		return false;
+	}
+
+	const pack_entry* find(const mounted_pack& pack, uint64_t hash, const char* name, uint32_t name_bytes){
+		const pack_entry* first = pack.entries;
+		const pack_entry* last = first + pack.header->count;
+
+		const pack_entry* it = std::lower_bound(first, last, hash, [](const pack_entry& e, uint64_t h){
+			return e.hash < h;
+		});
+		for (; it != last && it->hash == hash; ++it){
+			if (it->name_bytes == name_bytes && memcmp(pack.names + it->name_offset, name, name_bytes) == 0){
+				return it;
+			}
+		}
+		return nullptr;
+	}
+
+	struct build_entry{
+		std::string name;
+		pack_entry entry;
+	};
+	bool write_padding(FILE* file, uint64_t& offset, uint64_t alignment){
+		static const uint8_t zero[PACK_ALIGN] = {0};
+		uint64_t pad = align(offset, alignment) - offset;
+		offset += pad;
+		return pad == 0 || fwrite(zero, pad, 1, file) == 1;
+	}
+	bool collect_path(void* user, const file_match_t& match){
+		((std::vector<std::string>*)user)->emplace_back(match.path, match.path_bytes);
+		return true;
+	}
+}
+
+namespace io{ namespace pack{
+	bool mount(const char* pack_path){
+		io::prefetch::touch(pack_path);
+		int fd = open(pack_path, O_RDONLY);
+		if (fd < 0){
+			return false;
+		}
+
+		struct stat buf;
+		void* base = MAP_FAILED;
+		if (fstat(fd, &buf) == 0 && buf.st_size > 0){
+			base = mmap(nullptr, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		// The mapping keeps the file alive
+		close(fd);
+
+		if (base == MAP_FAILED){
+			return false;
+		}
+		if (!validate((const uint8_t*)base, buf.st_size)){
+			printf("pack: %s is not a valid pack\n", pack_path);
+			munmap(base, buf.st_size);
+			return false;
+		}
+
+		mounted_pack pack;
+		pack.path = pack_path;
+		pack.base = (const uint8_t*)base;
+		pack.bytes = buf.st_size;
+		pack.header = (const pack_header*)base;
+		pack.entries = (const pack_entry*)(pack.base + pack.header->index_offset);
+		pack.names = (const char*)(pack.base + pack.header->names_offset);
+		pack.stats = pack_stats_t{};
+
+		decompress(pack);
+		report(pack);
+
+		if (mounts == nullptr){
+			mounts = new std::vector<mounted_pack>;
+		}
+		mounts->push_back(pack);
+
+		return true;
+	}
+	void unmount(const char* pack_path){
+		if (mounts == nullptr){
+			return;
+		}
+		for (auto it = mounts->begin(); it != mounts->end(); ++it){
+			if (it->path == pack_path){
+				munmap((void*)it->base, it->bytes);
+				delete[] it->arena;
+				mounts->erase(it);
+				break;
+			}
+		}
+		if (mounts->empty()){
+			delete mounts;
+			mounts = nullptr;
+		}
+	}
+
+	bool stats(const char* pack_path, pack_stats_t& stats){
+		if (mounts){
+			for (const mounted_pack& pack : *mounts){
+				if (pack.path == pack_path){
+					stats = pack.stats;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool view(const char* path, file_view_t& view){
+		if (mounts == nullptr){
+			return false;
+		}
+
+		const char* name = normalize(path);
+		const uint32_t name_bytes = strlen(name);
+		const uint64_t hash = resource::hash64(name, name_bytes, 0);
+
+		for (auto it = mounts->rbegin(); it != mounts->rend(); ++it){
+			const pack_entry* entry = find(*it, hash, name, name_bytes);
+			if (entry){
+				const uint8_t* data = it->data[entry - it->entries];
+				if (data == nullptr){
+					return false;
+				}
+				view.data = data;
+				view.bytes = entry->raw_bytes;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool build(const char* pack_path, const char* root, bool compress){
+#ifndef PACK_HAVE_LZ4
+		if (compress){
+			printf("pack: built without LZ4, storing files uncompressed\n");
+			compress = false;
+		}
+#endif
+		std::vector<std::string> paths;
+		const char* everything = "*";
+		io::file::find_each(root, &everything, 1, true, collect_path, &paths);
+		const uint32_t count = paths.size();
+
+		FILE* file = fopen(pack_path, "wb");
+		if (!file){
+			return false;
+		}
+
+		pack_header header = {};
+		memcpy(header.magic, PACK_MAGIC, 4);
+		header.version = PACK_VERSION;
+		header.count = count;
+
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		uint64_t offset = sizeof(header);
+
+		std::vector<build_entry> entries(count);
+		std::vector<uint8_t> data, packed;
+		uint64_t raw_total = 0;
+
+		for (uint32_t i = 0; i < count && ok; ++i){
+			const char* path = paths[i].c_str();
+			build_entry& e = entries[i];
+			e.name = normalize(path);
+			e.entry.hash = resource::hash64(e.name.data(), e.name.size(), 0);
+			e.entry.name_bytes = e.name.size();
+
+			data.resize(io::file::size_on_disk(path));
+			data.resize(io::file::read(path, data.data(), data.size()));
+			e.entry.raw_bytes = data.size();
+			raw_total += data.size();
+
+			const std::vector<uint8_t>& stored = (compress && compress_entry(data, packed)) ? packed : data;
+			e.entry.flags = (&stored == &packed) ? PACK_ENTRY_LZ4 : 0;
+
+			ok = write_padding(file, offset, PACK_ALIGN);
+			e.entry.offset = offset;
+			e.entry.bytes = stored.size();
+			ok = ok && (stored.empty() || fwrite(stored.data(), stored.size(), 1, file) == 1);
+			offset += stored.size();
+		}
+
+		header.names_offset = offset;
+		uint32_t names_bytes = 0;
+		for (uint32_t i = 0; i < count && ok; ++i){
+			build_entry& e = entries[i];
+			e.entry.name_offset = names_bytes;
+			names_bytes += e.name.size();
+			ok = e.name.empty() || fwrite(e.name.data(), e.name.size(), 1, file) == 1;
+		}
+		offset += names_bytes;
+
+		std::sort(entries.begin(), entries.end(), [](const build_entry& a, const build_entry& b){
+			return a.entry.hash != b.entry.hash ? a.entry.hash < b.entry.hash : a.name < b.name;
+		});
+
+		ok = ok && write_padding(file, offset, sizeof(uint64_t));
+		header.index_offset = offset;
+		for (uint32_t i = 0; i < count && ok; ++i){
+			ok = fwrite(&entries[i].entry, sizeof(pack_entry), 1, file) == 1;
+		}
+
+		ok = ok && fseek(file, 0, SEEK_SET) == 0;
+		ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = (fclose(file) == 0) && ok;
+
+		if (ok){
+			printf("pack: wrote %u files from %s into %s, %lu bytes raw, %lu bytes packed\n",
+				count, root, pack_path, (unsigned long)raw_total, (unsigned long)offset);
+		}
+		return ok;
+	}
+}}
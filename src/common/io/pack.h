@@ -0,0 +1,69 @@
+#pragma once
+
+#include <inttypes.h>
+#include "file.h"
+
+/**
+ * Read-only archive of resource files, mapped into memory once when mounted
+ * so files can be used in place.
+ *
+ * Layout, little endian:
+ *   pack_header
+ *   file data, every file starting on a PACK_ALIGN boundary
+ *   names, not null-terminated
+ *   pack_entry[count], sorted by (hash, name)
+ *
+ * Names are paths relative to where the pack was built, without a leading "./"
+ *
+ * Entries flagged PACK_ENTRY_LZ4 are stored compressed. All of them are
+ * decompressed in parallel into one arena when the pack is mounted, so views
+ * look the same whether an entry was compressed or not.
+ **/
+#define PACK_MAGIC "CPAK"
+#define PACK_VERSION (2)
+#define PACK_ALIGN (16)
+
+#define PACK_ENTRY_LZ4 (1u << 0)
+
+struct pack_header{
+	char     magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+	uint64_t index_offset;
+	uint64_t names_offset;
+};
+struct pack_entry{
+	// resource::hash64 of the name
+	uint64_t hash;
+	uint64_t offset;
+	// Bytes stored in the pack, and after decompression
+	uint64_t bytes;
+	uint64_t raw_bytes;
+	uint32_t name_offset;
+	uint32_t name_bytes;
+	uint32_t flags;
+	uint32_t reserved;
+};
+
+struct pack_stats_t{
+	uint32_t files, compressed_files;
+	uint64_t stored_bytes, raw_bytes;
+	// Compressed entries only
+	uint64_t compressed_stored_bytes, compressed_raw_bytes;
+	float    decompress_seconds;
+};
+
+namespace io{ namespace pack{
+	// Decompresses every compressed entry before returning and prints a load report
+	bool mount(const char* pack_path);
+	void unmount(const char* pack_path);
+	bool stats(const char* pack_path, pack_stats_t& stats);
+
+	// Later mounts shadow earlier ones. False if no mounted pack holds the path
+	bool view(const char* path, file_view_t& view);
+
+	// Packs every file below root, names keep the root as their first component.
+	// With compress set, files that LZ4 shrinks meaningfully are stored compressed
+	bool build(const char* pack_path, const char* root, bool compress);
+}}
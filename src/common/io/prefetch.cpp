@@ -0,0 +1,165 @@
+#include "prefetch.h"
+#include "file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+	typedef std::chrono::steady_clock clock_type;
+
+	struct startup_phase{
+		const char* name;
+		float seconds;
+	};
+
+	struct prefetch_state{
+		std::string manifest_path;
+		clock_type::time_point start;
+
+		std::vector<std::string> manifest;
+		std::thread reader;
+		uint64_t prefetch_bytes;
+		float prefetch_seconds;
+
+		std::vector<std::string> touched;
+		std::unordered_set<std::string> seen;
+
+		std::vector<startup_phase> phases;
+	};
+
+	// Touched from worker threads too, image batches read in parallel. touch
+	// holds the lock while it records, so once finish has swapped the state
+	// out under it no thread can still be using it
+	std::atomic<prefetch_state*> state(nullptr);
+	std::mutex lock;
+
+	float since_start(const prefetch_state* s){
+		return std::chrono::duration<float>(clock_type::now() - s->start).count();
+	}
+
+	std::vector<std::string> read_manifest(const char* path){
+		std::vector<std::string> result;
+		std::string text(io::file::size_on_disk(path), '\0');
+		text.resize(io::file::read(path, &text[0], text.size()));
+
+		size_t begin = 0;
+		while (begin < text.size()){
+			size_t end = text.find('\n', begin);
+			end = end == std::string::npos ? text.size() : end;
+			if (end > begin){
+				result.push_back(text.substr(begin, end - begin));
+			}
+			begin = end + 1;
+		}
+		return result;
+	}
+
+	// Only starts the reads, the page cache holds on to the data once the file is closed
+	void prefetch_thread(prefetch_state* s){
+		for (const std::string& path : s->manifest){
+			int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0){
+				continue;
+			}
+			off_t bytes = lseek(fd, 0, SEEK_END);
+			(void)posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+			close(fd);
+
+			s->prefetch_bytes += bytes > 0 ? bytes : 0;
+		}
+		s->prefetch_seconds = std::chrono::duration<float>(clock_type::now() - s->start).count();
+	}
+}
+
+namespace io{ namespace prefetch{
+	void begin(const char* manifest_path){
+		if (state.load()){
+			return;
+		}
+		const clock_type::time_point start = clock_type::now();
+		// Read before recording starts so the manifest doesn't list itself
+		std::vector<std::string> manifest = read_manifest(manifest_path);
+
+		prefetch_state* s = new prefetch_state;
+		s->manifest_path = manifest_path;
+		s->start = start;
+		s->manifest.swap(manifest);
+		s->prefetch_bytes = 0;
+		s->prefetch_seconds = 0;
+
+		if (!s->manifest.empty()){
+			s->reader = std::thread(prefetch_thread, s);
+		}
+		state.store(s);
+	}
+	// Main thread only, like begin and finish
+	void mark(const char* phase){
+		prefetch_state* s = state.load();
+		if (s){
+			startup_phase p = {phase, since_start(s)};
+			s->phases.push_back(p);
+		}
+	}
+	void touch(const char* path){
+		if (state.load() == nullptr){
+			return;
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		prefetch_state* s = state.load();
+		if (s && s->seen.insert(path).second){
+			s->touched.push_back(path);
+		}
+	}
+	void finish(void){
+		if (state.load() == nullptr){
+			return;
+		}
+		mark("first frame");
+
+		prefetch_state* s;
+		{
+			// Nothing is recorded past here
+			std::lock_guard<std::mutex> guard(lock);
+			s = state.exchange(nullptr);
+		}
+		if (s->reader.joinable()){
+			s->reader.join();
+		}
+
+		if (s->touched.empty()){
+			// An empty write leaves the old file alone, and it would be prefetched again
+			unlink(s->manifest_path.c_str());
+		}
+		else if (s->touched != s->manifest){
+			std::string text;
+			for (const std::string& path : s->touched){
+				text.append(path).append(1, '\n');
+			}
+			io::file::write(s->manifest_path.c_str(), &text[0], text.size());
+		}
+
+		if (s->manifest.empty()){
+			printf("startup: no manifest yet, recorded %u files\n", (uint32_t)s->touched.size());
+		}
+		else{
+			printf("startup: prefetched %u files (%.1f KiB), done at %.2f ms\n",
+				(uint32_t)s->manifest.size(), s->prefetch_bytes / 1024.0, s->prefetch_seconds * 1000.f);
+		}
+		float last = 0;
+		for (const startup_phase& p : s->phases){
+			printf("startup: %-12s %8.2f ms (+%.2f ms)\n", p.name, p.seconds * 1000.f, (p.seconds - last) * 1000.f);
+			last = p.seconds;
+		}
+
+		delete s;
+	}
+}}
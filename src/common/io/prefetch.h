@@ -0,0 +1,24 @@
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * Startup readahead. render::initialize calls begin, which reads the
+ * manifest left by the previous run and has a background thread ask the
+ * kernel to start reading every file in it (posix_fadvise WILLNEED), so
+ * the disk works while SDL brings up the window and GL context.
+ *
+ * Until finish, which the first end_render calls, every file the library
+ * opens is recorded in first-touch order. finish writes that list back as
+ * the next manifest and prints how long each startup phase took.
+ **/
+#define PREFETCH_MANIFEST "./startup.manifest"
+
+namespace io{ namespace prefetch{
+	void begin(const char* manifest_path);
+	// Records the time since begin under a phase name, which must be a literal
+	void mark(const char* phase);
+	// Called by the file functions on every open
+	void touch(const char* path);
+	void finish(void);
+}}
@@ -0,0 +1,304 @@
+#include "watch.h"
+#include "event/event.h"
+#include "event/event_queue.h"
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+	const uint32_t WATCH_MASK = IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ATTRIB;
+
+	struct watched_dir{
+		int wd;
+		// Files and subdirectories by name
+		std::map<std::string, file_info_t> entries;
+	};
+	struct watch_state{
+		int fd;
+		std::vector<std::string> roots;
+		std::unordered_map<std::string, watched_dir> dirs;
+		std::unordered_map<int, std::string> by_wd;
+		std::vector<std::pair<watch_function, void*>> subscribers;
+	};
+
+	watch_state* state = nullptr;
+
+	bool ensure_state(void){
+		if (state == nullptr){
+			int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (fd < 0){
+				return false;
+			}
+			state = new watch_state;
+			state->fd = fd;
+			// Changes end a blocking wait, poll picks them up right after
+			event::queue::wake_on(fd);
+		}
+		return true;
+	}
+
+	// Paths are kept without a leading "./" or trailing '/', so any spelling finds them
+	std::string normalize(const char* path){
+		while (path[0] == '.' && path[1] == '/'){
+			path += 2;
+		}
+		std::string result(path);
+		while (result.size() > 1 && result.back() == '/'){
+			result.pop_back();
+		}
+		return result;
+	}
+	std::string join(const std::string& dir, const char* name){
+		return dir == "." ? std::string(name) : dir + "/" + name;
+	}
+
+	bool read_info(const std::string& path, file_info_t& info){
+		struct stat buf;
+		if (stat(path.c_str(), &buf) != 0){
+			return false;
+		}
+		info.size = S_ISDIR(buf.st_mode) ? 0 : buf.st_size;
+		info.mtime_ns = (int64_t)buf.st_mtim.tv_sec * 1000000000 + buf.st_mtim.tv_nsec;
+		info.directory = S_ISDIR(buf.st_mode);
+		return true;
+	}
+
+	// Watches dir and its subdirectories, breadth first so depth doesn't matter
+	void watch_tree(const std::string& root){
+		std::vector<std::string> pending(1, root);
+		while (!pending.empty()){
+			std::string path = std::move(pending.back());
+			pending.pop_back();
+			if (state->dirs.count(path)){
+				continue;
+			}
+
+			int wd = inotify_add_watch(state->fd, path.c_str(), WATCH_MASK | IN_ONLYDIR);
+			if (wd < 0){
+				continue;
+			}
+			watched_dir& dir = state->dirs[path];
+			dir.wd = wd;
+			state->by_wd[wd] = path;
+
+			// Listed after the watch is in place so nothing can slip between the two
+			DIR* dr = opendir(path.c_str());
+			if (dr == nullptr){
+				continue;
+			}
+			while (struct dirent* de = readdir(dr)){
+				const char* name = de->d_name;
+				if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))){
+					continue;
+				}
+
+				std::string child = join(path, name);
+				file_info_t info;
+				if (!read_info(child, info)){
+					continue;
+				}
+				dir.entries[name] = info;
+				if (info.directory && name[0] != '.'){
+					pending.push_back(std::move(child));
+				}
+			}
+			closedir(dr);
+		}
+	}
+	void unwatch_tree(const std::string& root){
+		const std::string prefix = root + "/";
+		for (auto it = state->dirs.begin(); it != state->dirs.end();){
+			if (it->first == root || it->first.compare(0, prefix.size(), prefix) == 0){
+				inotify_rm_watch(state->fd, it->second.wd);
+				state->by_wd.erase(it->second.wd);
+				it = state->dirs.erase(it);
+			}
+			else{
+				++it;
+			}
+		}
+	}
+
+	void note_change(std::vector<std::pair<std::string, uint32_t>>& changes, const std::string& path, uint32_t kind){
+		// Editors tend to touch a file several times per save, report it once
+		for (auto& change : changes){
+			if (change.first == path){
+				change.second = kind;
+				return;
+			}
+		}
+		changes.emplace_back(path, kind);
+	}
+	void apply(const struct inotify_event* ev, std::vector<std::pair<std::string, uint32_t>>& changes){
+		auto found = state->by_wd.find(ev->wd);
+		if (found == state->by_wd.end() || ev->len == 0){
+			return;
+		}
+		// Copied, watch_tree can rehash dirs
+		const std::string dir_path = found->second;
+		const std::string path = join(dir_path, ev->name);
+
+		if (ev->mask & (IN_DELETE | IN_MOVED_FROM)){
+			state->dirs[dir_path].entries.erase(ev->name);
+			if (ev->mask & IN_ISDIR){
+				unwatch_tree(path);
+			}
+			else{
+				note_change(changes, path, FILE_CHANGE_REMOVED);
+			}
+			return;
+		}
+
+		file_info_t info;
+		if (!read_info(path, info)){
+			return;
+		}
+		state->dirs[dir_path].entries[ev->name] = info;
+
+		if (info.directory){
+			if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) && ev->name[0] != '.'){
+				watch_tree(path);
+			}
+		}
+		// Creation alone isn't reported, the contents arrive with the close
+		else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)){
+			note_change(changes, path, FILE_CHANGE_WRITTEN);
+		}
+	}
+}
+
+namespace io{ namespace watch{
+	bool add(const char* root){
+		if (!ensure_state()){
+			return false;
+		}
+
+		std::string path = normalize(root);
+		file_info_t info;
+		if (!read_info(path, info) || !info.directory){
+			return false;
+		}
+		state->roots.push_back(path);
+		watch_tree(path);
+		return true;
+	}
+	void shutdown(void){
+		if (state == nullptr){
+			return;
+		}
+		event::queue::stop_waking_on(state->fd);
+		close(state->fd);
+		delete state;
+		state = nullptr;
+	}
+
+	uint32_t poll(void){
+		if (state == nullptr){
+			return 0;
+		}
+
+		std::vector<std::pair<std::string, uint32_t>> changes;
+		alignas(struct inotify_event) char buffer[16 * 1024];
+		for (;;){
+			ssize_t bytes = read(state->fd, buffer, sizeof(buffer));
+			if (bytes < 0 && errno == EINTR){
+				continue;
+			}
+			if (bytes <= 0){
+				break;
+			}
+
+			for (ssize_t pos = 0; pos < bytes;){
+				const struct inotify_event* ev = (const struct inotify_event*)(buffer + pos);
+				pos += sizeof(struct inotify_event) + ev->len;
+
+				if (ev->mask & IN_Q_OVERFLOW){
+					// Events were lost, start over from what is on disk
+					std::vector<std::string> roots = state->roots;
+					for (const std::string& root : roots){
+						unwatch_tree(root);
+						watch_tree(root);
+					}
+					continue;
+				}
+				apply(ev, changes);
+			}
+		}
+
+		for (const auto& it : changes){
+			file_change_t change;
+			change.path = it.first.c_str();
+			change.path_bytes = it.first.size();
+			change.kind = it.second;
+
+			for (const auto& sub : state->subscribers){
+				sub.first(sub.second, change);
+			}
+			event::call_event_handler(EVENT_FILE_CHANGED, &change);
+		}
+		return changes.size();
+	}
+
+	watch_lookup_t lookup(const char* path, file_info_t& info){
+		if (state == nullptr){
+			return WATCH_UNKNOWN;
+		}
+
+		std::string key = normalize(path);
+		if (state->dirs.count(key)){
+			info.size = 0;
+			info.mtime_ns = 0;
+			info.directory = true;
+			return WATCH_FOUND;
+		}
+
+		size_t slash = key.rfind('/');
+		auto dir = state->dirs.find(slash == std::string::npos ? std::string(".") : key.substr(0, slash));
+		if (dir == state->dirs.end()){
+			return WATCH_UNKNOWN;
+		}
+
+		auto entry = dir->second.entries.find(slash == std::string::npos ? key : key.substr(slash + 1));
+		if (entry == dir->second.entries.end()){
+			return WATCH_MISSING;
+		}
+		info = entry->second;
+		return WATCH_FOUND;
+	}
+	bool list(const char* dir, watch_list_function fn, void* user){
+		if (state == nullptr){
+			return false;
+		}
+		auto found = state->dirs.find(normalize(dir));
+		if (found == state->dirs.end()){
+			return false;
+		}
+		for (const auto& entry : found->second.entries){
+			fn(user, entry.first.c_str(), entry.second);
+		}
+		return true;
+	}
+
+	void subscribe(watch_function fn, void* user){
+		if (ensure_state()){
+			state->subscribers.emplace_back(fn, user);
+		}
+	}
+	void unsubscribe(watch_function fn, void* user){
+		if (state){
+			auto& subs = state->subscribers;
+			subs.erase(std::remove(subs.begin(), subs.end(), std::make_pair(fn, user)), subs.end());
+		}
+	}
+}}
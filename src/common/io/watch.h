@@ -0,0 +1,63 @@
+#pragma once
+
+#include <inttypes.h>
+
+/**
+ * In-memory copy of the metadata under watched directories, kept current by
+ * inotify. While a directory is watched, io::file::exists, size and find
+ * answer from here instead of asking the filesystem, and can lag a write by
+ * up to a frame. Reads never consult it.
+ *
+ * Changes are picked up by poll, which event::poll_events and the waits
+ * call, and a change ends a blocking wait. Every file that was written or
+ * removed since the last poll is passed to the subscribers and then raised
+ * as an EVENT_FILE_CHANGED event.
+ *
+ * Updates only happen in poll, on the main thread. Lookups from other
+ * threads are safe while nothing is polling.
+ **/
+struct file_info_t{
+	uint64_t size;
+	int64_t  mtime_ns;
+	bool     directory;
+};
+
+enum file_change_kind_t{
+	// Created, rewritten or moved into place
+	FILE_CHANGE_WRITTEN = 0,
+	FILE_CHANGE_REMOVED,
+};
+
+// Passed as event_data for EVENT_FILE_CHANGED. path is only valid during the call
+struct file_change_t{
+	const char* path;
+	uint32_t    path_bytes;
+	uint32_t    kind;
+};
+
+enum watch_lookup_t{
+	// Not under a watched directory, ask the filesystem
+	WATCH_UNKNOWN = 0,
+	WATCH_MISSING,
+	WATCH_FOUND,
+};
+
+typedef void (*watch_function)(void* user, const file_change_t& change);
+typedef void (*watch_list_function)(void* user, const char* name, const file_info_t& info);
+
+namespace io{ namespace watch{
+	// Watches root and everything below it, hidden directories excepted
+	bool add(const char* root);
+	void shutdown(void);
+
+	// Applies pending changes, returns how many files changed
+	uint32_t poll(void);
+
+	watch_lookup_t lookup(const char* path, file_info_t& info);
+	// Calls fn for every entry directly inside dir, in name order. False if dir isn't watched
+	bool list(const char* dir, watch_list_function fn, void* user);
+
+	// Subscribers hear about changes before the event is raised
+	void subscribe  (watch_function fn, void* user);
+	void unsubscribe(watch_function fn, void* user);
+}}
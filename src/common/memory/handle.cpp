@@ -0,0 +1,155 @@
+#include "handle.h"
+
+#include <string.h>
+
+namespace {
+	const uint32_t INDEX_MASK = HANDLE_MAX_CAPACITY;
+	const uint32_t GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+	const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+	struct handle_slot{
+		uintptr_t value;
+		uint64_t  bytes;
+		uint32_t  generation;
+		// Next slot in the free list while the slot is unused
+		uint32_t  next_free;
+	};
+
+	struct handle_pool{
+		handle_slot* slots;
+		uint32_t capacity;
+		// Slots at or past high_water have never been handed out and are
+		// implicitly free, so the free list never needs building up front
+		uint32_t high_water;
+		uint32_t free_head;
+		uint32_t live;
+		uint64_t bytes;
+	};
+
+	handle_pool pools[HANDLE_TYPE_COUNT] = {};
+
+	void grow(handle_pool& pool, uint32_t capacity){
+		if (capacity > HANDLE_MAX_CAPACITY){
+			capacity = HANDLE_MAX_CAPACITY;
+		}
+		if (capacity <= pool.capacity){
+			return;
+		}
+
+		handle_slot* slots = new handle_slot[capacity];
+		if (pool.slots){
+			memcpy(slots, pool.slots, pool.high_water * sizeof(handle_slot));
+			delete[] pool.slots;
+		}
+		else{
+			pool.free_head = NO_SLOT;
+		}
+		pool.slots = slots;
+		pool.capacity = capacity;
+	}
+	handle_pool& get_pool(handle_type_t type){
+		handle_pool& pool = pools[type];
+		if (pool.slots == nullptr){
+			grow(pool, HANDLE_DEFAULT_CAPACITY);
+		}
+		return pool;
+	}
+	inline uint32_t make_handle(uint32_t index, uint32_t generation){
+		return (generation << HANDLE_INDEX_BITS) | index;
+	}
+	inline handle_slot* resolve(handle_pool& pool, uint32_t handle){
+		uint32_t index = handle & INDEX_MASK;
+		uint32_t generation = handle >> HANDLE_INDEX_BITS;
+
+		if (index < pool.high_water && pool.slots[index].generation == generation){
+			return pool.slots + index;
+		}
+		return nullptr;
+	}
+}
+
+void handle_set_capacity(handle_type_t type, uint32_t capacity){
+	grow(pools[type], capacity);
+}
+
+uint32_t handle_alloc(handle_type_t type, uintptr_t value, uint64_t bytes){
+	handle_pool& pool = get_pool(type);
+
+	uint32_t index = NO_SLOT;
+	if (pool.free_head != NO_SLOT){
+		index = pool.free_head;
+		pool.free_head = pool.slots[index].next_free;
+	}
+	else if (pool.high_water < pool.capacity){
+		index = pool.high_water++;
+		// Generation 0 is reserved so that no handle can be 0
+		pool.slots[index].generation = 1;
+	}
+	else{
+		return 0;
+	}
+
+	handle_slot& slot = pool.slots[index];
+	slot.value = value;
+	slot.bytes = bytes;
+	slot.next_free = NO_SLOT;
+
+	++pool.live;
+	pool.bytes += bytes;
+
+	return make_handle(index, slot.generation);
+}
+void handle_free(handle_type_t type, uint32_t handle){
+	handle_pool& pool = pools[type];
+	handle_slot* slot = resolve(pool, handle);
+	if (slot == nullptr){
+		return;
+	}
+
+	--pool.live;
+	pool.bytes -= slot->bytes;
+
+	slot->value = 0;
+	slot->bytes = 0;
+	slot->generation = (slot->generation + 1) & GENERATION_MASK;
+	slot->generation += (slot->generation == 0);
+
+	slot->next_free = pool.free_head;
+	pool.free_head = (uint32_t)(slot - pool.slots);
+}
+
+int handle_valid(handle_type_t type, uint32_t handle){
+	return resolve(pools[type], handle) != nullptr;
+}
+uintptr_t handle_get(handle_type_t type, uint32_t handle){
+	handle_slot* slot = resolve(pools[type], handle);
+	return slot ? slot->value : 0;
+}
+
+int handle_swap(handle_type_t type, uint32_t a, uint32_t b){
+	handle_slot* sa = resolve(pools[type], a);
+	handle_slot* sb = resolve(pools[type], b);
+	if (sa == nullptr || sb == nullptr){
+		return 0;
+	}
+
+	uintptr_t value = sa->value;
+	uint64_t bytes = sa->bytes;
+	sa->value = sb->value;
+	sa->bytes = sb->bytes;
+	sb->value = value;
+	sb->bytes = bytes;
+
+	return 1;
+}
+
+handle_stats_t handle_stats(handle_type_t type){
+	const handle_pool& pool = pools[type];
+
+	handle_stats_t result = {0};
+	result.live = pool.live;
+	result.capacity = pool.capacity;
+	result.bytes = pool.bytes;
+
+	return result;
+}
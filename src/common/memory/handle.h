@@ -0,0 +1,58 @@
+#ifndef H_MEMORY_HANDLE_H
+#define H_MEMORY_HANDLE_H
+
+#include <inttypes.h>
+#include <stdint.h>
+
+/**
+ * Generational handles for resources handed out through the api.
+ * A handle packs the slot index in the low HANDLE_INDEX_BITS and the slot
+ * generation above it. Freeing a slot bumps its generation, so a stale
+ * handle no longer resolves once its slot is reused. 0 is never valid.
+ *
+ * Pools are not thread safe, resources are created on the main thread.
+ **/
+
+#define HANDLE_INDEX_BITS (20)
+#define HANDLE_MAX_CAPACITY ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_DEFAULT_CAPACITY (1024)
+
+typedef enum {
+	HANDLE_IMAGE = 0,
+	HANDLE_TEXTURE,
+	HANDLE_SHADER,
+	HANDLE_TIMER,
+
+	HANDLE_TYPE_COUNT
+} handle_type_t;
+
+typedef struct {
+	uint32_t live, capacity;
+	uint64_t bytes;
+} handle_stats_t;
+
+#ifdef __cplusplus
+#define EXTERN extern "C"
+#else
+#define EXTERN
+#endif
+
+// Capacity can only grow, the request is clamped to HANDLE_MAX_CAPACITY
+EXTERN void           handle_set_capacity(handle_type_t type, uint32_t capacity);
+
+// Returns 0 when the pool is full
+EXTERN uint32_t       handle_alloc(handle_type_t type, uintptr_t value, uint64_t bytes);
+EXTERN void           handle_free (handle_type_t type, uint32_t handle);
+
+EXTERN int            handle_valid(handle_type_t type, uint32_t handle);
+// Returns 0 for stale or invalid handles
+EXTERN uintptr_t      handle_get  (handle_type_t type, uint32_t handle);
+
+// Exchanges what two live handles refer to, so a resource can be rebuilt behind
+// a handle that is already in use. Returns 0 if either handle is stale
+EXTERN int            handle_swap (handle_type_t type, uint32_t a, uint32_t b);
+
+EXTERN handle_stats_t handle_stats(handle_type_t type);
+
+#undef EXTERN
+#endif
@@ -0,0 +1,408 @@
+#include "cache.h"
+#include "hash.h"
+#include "embedded.h"
+
+#include "io/file.h"
+#include "io/pack.h"
+#include "io/watch.h"
+#include "memory/handle.h"
+#include "graphics/image.h"
+#include "graphics/shader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	enum resource_kind{
+		KIND_IMAGE = 0,
+		KIND_TEXTURE,
+		KIND_SHADER,
+
+		KIND_COUNT
+	};
+
+	struct cache_entry{
+		uint32_t kind;
+		uint32_t handle;
+		uint32_t refs;
+		uint64_t content;
+		// Every path key that resolved to this entry
+		std::vector<std::string> paths;
+
+		// What it was loaded from, for hot reload
+		std::vector<std::string> files;
+		texture_options_t options;
+	};
+
+	struct resource_cache{
+		std::unordered_map<std::string, cache_entry*> by_path;
+		std::unordered_map<uint64_t, cache_entry*> by_content;
+		std::unordered_map<uint32_t, cache_entry*> by_handle[KIND_COUNT];
+	};
+
+	resource_cache* cache = nullptr;
+
+	resource_cache& get_cache(void){
+		if (cache == nullptr){
+			cache = new resource_cache;
+		}
+		return *cache;
+	}
+
+	// Checked before anything else, so files can be swapped without a rebuild
+	std::string* override_dir = nullptr;
+
+	// Embedded files and files in a mounted pack are used in place, anything else is mapped
+	struct file_data{
+		file_view_t view = {nullptr, 0};
+		bool mapped = false;
+
+		~file_data(void){
+			if (mapped){
+				io::file::unmap(view);
+			}
+		}
+
+		inline void* data(void){ return (void*)view.data; }
+		inline uint32_t size(void){ return (uint32_t)view.bytes; }
+	};
+	// Same spelling as io::watch reports, without a leading "./"
+	const char* file_name(const char* path){
+		while (path[0] == '.' && path[1] == '/'){
+			path += 2;
+		}
+		return path;
+	}
+
+	// Looks in the override directory, then the library, then the mounted packs,
+	// then on disk. Reloads skip the built in copies, the point is to see what
+	// just changed on disk
+	bool read_file(const char* path, file_data& file, bool built_in = true){
+		if (override_dir){
+			std::string local = *override_dir + "/" + file_name(path);
+			file.mapped = io::file::map(local.c_str(), file.view, FILE_ACCESS_SEQUENTIAL);
+			if (file.mapped){
+				return file.view.bytes > 0;
+			}
+		}
+		if (built_in && (resource::embedded(path, file.view) || io::pack::view(path, file.view))){
+			return true;
+		}
+
+		// Decoders read each file once from the front
+		file.mapped = io::file::map(path, file.view, FILE_ACCESS_SEQUENTIAL);
+		return file.view.bytes > 0;
+	}
+
+	// The kind and creation options take part in both keys so the same file
+	// loaded as an image and as a texture, or with different options, stays apart
+	std::string path_key(resource_kind kind, const void* opt, uint32_t opt_bytes, const char* path){
+		std::string key(1, (char)kind);
+		key.append((const char*)opt, opt_bytes);
+		key.append(path);
+		return key;
+	}
+	uint64_t content_hash(resource_kind kind, const texture_options_t* opt, file_data* data, uint32_t count){
+		uint64_t hash = resource::hash64(opt, opt ? sizeof(*opt) : 0, kind);
+		for (uint32_t i = 0; i < count; ++i){
+			hash = resource::hash64(data[i].data(), data[i].size(), hash);
+		}
+		return hash;
+	}
+	// A hash hit is only a candidate, the bytes decide. The entry's files are
+	// read again, which is a lookup for embedded and packed files and a map otherwise
+	bool same_content(const cache_entry* entry, resource_kind kind, const texture_options_t* opt, file_data* data, uint32_t count){
+		if (entry->kind != (uint32_t)kind || entry->files.size() != count){
+			return false;
+		}
+		if (opt && memcmp(&entry->options, opt, sizeof(*opt)) != 0){
+			return false;
+		}
+		for (uint32_t i = 0; i < count; ++i){
+			file_data other;
+			if (!read_file(entry->files[i].c_str(), other) || other.size() != data[i].size() ||
+				memcmp(other.data(), data[i].data(), data[i].size()) != 0){
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t acquire(resource_cache& c, cache_entry* entry, const std::string& key){
+		if (c.by_path.count(key) == 0){
+			entry->paths.push_back(key);
+			c.by_path[key] = entry;
+		}
+		++entry->refs;
+		return entry->handle;
+	}
+	// Returns the handle of an entry with identical content, or 0
+	uint32_t find_content(resource_cache& c, uint64_t content, const std::string& key, resource_kind kind, const texture_options_t* opt, file_data* data, uint32_t count){
+		auto found = c.by_content.find(content);
+		if (found == c.by_content.end() || !same_content(found->second, kind, opt, data, count)){
+			return 0;
+		}
+		return acquire(c, found->second, key);
+	}
+	// A colliding hash keeps the entry already there, the newcomer just isn't shared
+	void add_content(resource_cache& c, cache_entry* entry){
+		c.by_content.emplace(entry->content, entry);
+	}
+	void remove_content(resource_cache& c, cache_entry* entry){
+		auto found = c.by_content.find(entry->content);
+		if (found != c.by_content.end() && found->second == entry){
+			c.by_content.erase(found);
+		}
+	}
+	cache_entry* insert(resource_cache& c, resource_kind kind, uint32_t handle, uint64_t content, const std::string& key, uint32_t& result){
+		result = 0;
+		if (handle == 0){
+			return nullptr;
+		}
+
+		cache_entry* entry = new cache_entry;
+		entry->kind = kind;
+		entry->handle = handle;
+		entry->refs = 0;
+		entry->content = content;
+		entry->options = texture_default_options();
+
+		add_content(c, entry);
+		c.by_handle[kind][handle] = entry;
+
+		result = acquire(c, entry, key);
+		return entry;
+	}
+
+	void destroy(cache_entry* entry){
+		switch (entry->kind){
+			case KIND_IMAGE:   { image_free(entry->handle); break; }
+			case KIND_TEXTURE: { texture_destroy(entry->handle); break; }
+			case KIND_SHADER:  { shader_destroy_program(entry->handle); break; }
+		}
+	}
+	void release(resource_kind kind, uint32_t handle){
+		if (cache == nullptr){
+			return;
+		}
+		auto found = cache->by_handle[kind].find(handle);
+		if (found == cache->by_handle[kind].end()){
+			return;
+		}
+
+		cache_entry* entry = found->second;
+		if (--entry->refs > 0){
+			return;
+		}
+
+		for (const std::string& key : entry->paths){
+			cache->by_path.erase(key);
+		}
+		remove_content(*cache, entry);
+		cache->by_handle[kind].erase(found);
+
+		destroy(entry);
+		delete entry;
+	}
+
+	// Builds a fresh resource from the files on disk and swaps it in behind the old handle
+	void reload(cache_entry* entry){
+		file_data data[2];
+		for (uint32_t i = 0; i < entry->files.size(); ++i){
+			if (!read_file(entry->files[i].c_str(), data[i], false)){
+				return;
+			}
+		}
+
+		uint32_t fresh = 0;
+		handle_type_t type = HANDLE_IMAGE;
+		switch (entry->kind){
+			case KIND_IMAGE:{
+				fresh = image_load_lump(data[0].data(), data[0].size());
+				type = HANDLE_IMAGE;
+				break;
+			}
+			case KIND_TEXTURE:{
+				fresh = texture_create_ex(data[0].data(), data[0].size(), &entry->options);
+				type = HANDLE_TEXTURE;
+				break;
+			}
+			case KIND_SHADER:{
+				fresh = shader_create_program(data[0].data(), data[1].data(), nullptr, data[0].size(), data[1].size(), 0);
+				type = HANDLE_SHADER;
+				break;
+			}
+		}
+		if (fresh == 0){
+			printf("resource: reloading %s failed, keeping the old one\n", entry->files[0].c_str());
+			return;
+		}
+
+		// The old object ends up behind the fresh handle and is destroyed with it
+		handle_swap(type, entry->handle, fresh);
+		uint32_t handle = entry->handle;
+		entry->handle = fresh;
+		destroy(entry);
+		entry->handle = handle;
+
+		// Shared from now on under what the files hold now
+		const texture_options_t* opt = entry->kind == KIND_TEXTURE ? &entry->options : nullptr;
+		remove_content(*cache, entry);
+		entry->content = content_hash((resource_kind)entry->kind, opt, data, entry->files.size());
+		add_content(*cache, entry);
+		printf("resource: reloaded %s\n", entry->files[0].c_str());
+	}
+	void file_changed(void*, const file_change_t& change){
+		if (cache == nullptr || change.kind != FILE_CHANGE_WRITTEN){
+			return;
+		}
+
+		// Files under the override directory stand in for the same name without it
+		const char* path = change.path;
+		uint32_t path_bytes = change.path_bytes;
+		if (override_dir){
+			const std::string prefix = std::string(file_name(override_dir->c_str())) + "/";
+			if (path_bytes > prefix.size() && memcmp(path, prefix.data(), prefix.size()) == 0){
+				path += prefix.size();
+				path_bytes -= prefix.size();
+			}
+		}
+		for (auto& kind : cache->by_handle){
+			for (auto& it : kind){
+				cache_entry* entry = it.second;
+				for (const std::string& file : entry->files){
+					if (file.size() == path_bytes && memcmp(file.data(), path, path_bytes) == 0){
+						reload(entry);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+namespace resource{
+	uint32_t load_image(const char* path){
+		resource_cache& c = get_cache();
+		std::string key = path_key(KIND_IMAGE, nullptr, 0, path);
+
+		auto found = c.by_path.find(key);
+		if (found != c.by_path.end()){
+			return acquire(c, found->second, key);
+		}
+
+		file_data data;
+		if (!read_file(path, data)){
+			return 0;
+		}
+
+		uint64_t content = content_hash(KIND_IMAGE, nullptr, &data, 1);
+		uint32_t result = find_content(c, content, key, KIND_IMAGE, nullptr, &data, 1);
+		if (result == 0){
+			cache_entry* entry = insert(c, KIND_IMAGE, image_load_lump(data.data(), data.size()), content, key, result);
+			if (entry){
+				entry->files.push_back(file_name(path));
+			}
+		}
+		return result;
+	}
+	uint32_t load_texture(const char* path, const texture_options_t* opt){
+		texture_options_t options = texture_default_options();
+		options.alpha = 1;
+		if (opt){
+			options = *opt;
+		}
+
+		resource_cache& c = get_cache();
+		std::string key = path_key(KIND_TEXTURE, &options, sizeof(options), path);
+
+		auto found = c.by_path.find(key);
+		if (found != c.by_path.end()){
+			return acquire(c, found->second, key);
+		}
+
+		file_data data;
+		if (!read_file(path, data)){
+			return 0;
+		}
+
+		uint64_t content = content_hash(KIND_TEXTURE, &options, &data, 1);
+		uint32_t result = find_content(c, content, key, KIND_TEXTURE, &options, &data, 1);
+		if (result == 0){
+			cache_entry* entry = insert(c, KIND_TEXTURE, texture_create_ex(data.data(), data.size(), &options), content, key, result);
+			if (entry){
+				entry->files.push_back(file_name(path));
+				entry->options = options;
+			}
+		}
+		return result;
+	}
+	uint32_t load_shader(const char* vpath, const char* fpath){
+		resource_cache& c = get_cache();
+		std::string key = path_key(KIND_SHADER, nullptr, 0, vpath);
+		key.push_back('\0');
+		key.append(fpath);
+
+		auto found = c.by_path.find(key);
+		if (found != c.by_path.end()){
+			return acquire(c, found->second, key);
+		}
+
+		file_data data[2];
+		if (!read_file(vpath, data[0]) || !read_file(fpath, data[1])){
+			return 0;
+		}
+
+		uint64_t content = content_hash(KIND_SHADER, nullptr, data, 2);
+		uint32_t result = find_content(c, content, key, KIND_SHADER, nullptr, data, 2);
+		if (result == 0){
+			uint32_t prog = shader_create_program(data[0].data(), data[1].data(), nullptr, data[0].size(), data[1].size(), 0);
+			cache_entry* entry = insert(c, KIND_SHADER, prog, content, key, result);
+			if (entry){
+				entry->files.push_back(file_name(vpath));
+				entry->files.push_back(file_name(fpath));
+			}
+		}
+		return result;
+	}
+
+	void release_image(uint32_t img){
+		release(KIND_IMAGE, img);
+	}
+	void release_texture(uint32_t tex){
+		release(KIND_TEXTURE, tex);
+	}
+	void release_shader(uint32_t prog){
+		release(KIND_SHADER, prog);
+	}
+
+	void clear(void){
+		if (cache == nullptr){
+			return;
+		}
+		for (auto& kind : cache->by_handle){
+			for (auto& it : kind){
+				destroy(it.second);
+				delete it.second;
+			}
+		}
+		delete cache;
+		cache = nullptr;
+	}
+
+	void set_override_dir(const char* dir){
+		delete override_dir;
+		override_dir = dir ? new std::string(dir) : nullptr;
+	}
+
+	void hot_reload(bool enable){
+		io::watch::unsubscribe(file_changed, nullptr);
+		if (enable){
+			io::watch::subscribe(file_changed, nullptr);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <inttypes.h>
+#include "graphics/texture.h"
+
+/**
+ * Shared, refcounted resources. Loads are keyed by path first, so a repeat
+ * load of the same path is a single table lookup. A path that hasn't been
+ * seen is read and hashed, and if the content matches something already
+ * loaded (a copy under another name, compared byte for byte on a hash hit)
+ * the existing resource is shared. A hot reload rehashes what was reloaded.
+ *
+ * Files are looked for in the override directory if one is set, then in
+ * the resources embedded in the library, then in mounted packs, and last
+ * on disk.
+ *
+ * Every successful load must be paired with the matching release. The
+ * handles are the ordinary image/texture/shader handles.
+ **/
+namespace resource{
+	uint32_t load_image(const char* path);
+	// opt may be null for texture_create_alpha's defaults
+	uint32_t load_texture(const char* path, const texture_options_t* opt);
+	uint32_t load_shader(const char* vpath, const char* fpath);
+
+	void release_image(uint32_t img);
+	void release_texture(uint32_t tex);
+	void release_shader(uint32_t prog);
+
+	// "mods" makes ./resource/shader.vs load from mods/resource/shader.vs when
+	// that exists. Null turns it off
+	void set_override_dir(const char* dir);
+
+	// Destroys everything still cached regardless of refcounts
+	void clear(void);
+
+	// Rebuilds cached resources in place when their files change under a
+	// directory watched with io::watch::add. Handles stay the same, and a
+	// file that fails to load keeps the previous version
+	void hot_reload(bool enable);
+}
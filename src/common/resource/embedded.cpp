@@ -0,0 +1,26 @@
+#include "embedded.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace resource{
+	bool embedded(const char* path, file_view_t& view){
+		while (path[0] == '.' && path[1] == '/'){
+			path += 2;
+		}
+
+		const embedded_file_t* first = embedded_files;
+		const embedded_file_t* last = embedded_files + embedded_file_count;
+		const embedded_file_t* it = std::lower_bound(first, last, path, [](const embedded_file_t& f, const char* name){
+			return strcmp(f.name, name) < 0;
+		});
+		if (it == last || strcmp(it->name, path) != 0){
+			return false;
+		}
+
+		view.data = it->data;
+		view.bytes = it->bytes;
+		return true;
+	}
+}
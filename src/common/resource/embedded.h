@@ -0,0 +1,24 @@
+#pragma once
+
+#include <inttypes.h>
+#include "io/file.h"
+
+/**
+ * Resources compiled into the library at build time (EMBEDDED_RESOURCES in
+ * the library's CMakeLists.txt), so the default assets load without any
+ * file I/O. Names are relative to bin, "resource/shader.vs".
+ **/
+struct embedded_file_t{
+	const char*    name;
+	const uint8_t* data;
+	uint64_t       bytes;
+};
+
+namespace resource{
+	// Generated, sorted by name
+	extern const embedded_file_t embedded_files[];
+	extern const uint32_t embedded_file_count;
+
+	// Accepts any leading "./"
+	bool embedded(const char* path, file_view_t& view);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace resource{
+	// XXH64, compatible with the reference xxHash implementation
+	uint64_t hash64(const void* data, size_t bytes, uint64_t seed);
+}
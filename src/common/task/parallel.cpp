@@ -0,0 +1,146 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+	struct parallel_job{
+		std::atomic<uint32_t> next;
+		uint32_t count;
+		task::parallel_function fn;
+		void* user;
+	};
+
+	void run_job(parallel_job* job){
+		uint32_t ndx;
+		while ((ndx = job->next.fetch_add(1, std::memory_order_relaxed)) < job->count){
+			job->fn(job->user, ndx);
+		}
+	}
+
+	// Threads sleep on work between jobs. One job runs at a time, callers that
+	// find the pool busy (including calls made from inside a job) run alone
+	struct worker_pool{
+		std::vector<std::thread> threads;
+		std::mutex submit;
+
+		std::mutex lock;
+		std::condition_variable work;
+		std::condition_variable done;
+		parallel_job* job;
+		uint64_t generation;
+		uint32_t finished;
+		bool stopping;
+
+		worker_pool(void):job(nullptr), generation(0), finished(0), stopping(false){}
+	};
+
+	std::mutex pool_lock;
+	worker_pool* pool = nullptr;
+
+	void pool_thread(worker_pool* p){
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> guard(p->lock);
+		for (;;){
+			p->work.wait(guard, [p, seen]{ return p->stopping || p->generation != seen; });
+			if (p->stopping){
+				return;
+			}
+			seen = p->generation;
+			parallel_job* job = p->job;
+			guard.unlock();
+
+			run_job(job);
+
+			guard.lock();
+			if (++p->finished == p->threads.size()){
+				p->done.notify_one();
+			}
+		}
+	}
+
+	// Called with pool_lock held
+	void start_pool(void){
+		if (pool != nullptr){
+			return;
+		}
+		pool = new worker_pool();
+		const uint32_t nthreads = task::worker_count() - 1;
+		for (uint32_t i = 0; i < nthreads; ++i){
+			pool->threads.push_back(std::thread(pool_thread, pool));
+		}
+	}
+	worker_pool* get_pool(void){
+		std::lock_guard<std::mutex> guard(pool_lock);
+		start_pool();
+		return pool;
+	}
+}
+
+namespace task{
+	uint32_t worker_count(void){
+		uint32_t n = std::thread::hardware_concurrency();
+		return n ? n : 1;
+	}
+
+	void initialize(void){
+		std::lock_guard<std::mutex> guard(pool_lock);
+		start_pool();
+	}
+	void shutdown(void){
+		std::lock_guard<std::mutex> guard(pool_lock);
+		if (pool == nullptr){
+			return;
+		}
+		{
+			// Waits out a running job
+			std::lock_guard<std::mutex> submit(pool->submit);
+			std::lock_guard<std::mutex> wake(pool->lock);
+			pool->stopping = true;
+			pool->work.notify_all();
+		}
+		for (std::thread& t : pool->threads){
+			t.join();
+		}
+		delete pool;
+		pool = nullptr;
+	}
+
+	void parallel_for(uint32_t count, parallel_function fn, void* user){
+		if (count == 0){
+			return;
+		}
+
+		parallel_job job;
+		job.next = 0;
+		job.count = count;
+		job.fn = fn;
+		job.user = user;
+
+		worker_pool* p = count > 1 ? get_pool() : nullptr;
+		if (p == nullptr || p->threads.empty() || !p->submit.try_lock()){
+			run_job(&job);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(p->lock);
+			p->job = &job;
+			p->finished = 0;
+			++p->generation;
+			p->work.notify_all();
+		}
+		run_job(&job);
+		{
+			// Every index is taken, but workers can still be inside fn or about
+			// to pick the job up. It lives on this stack so wait for all of them
+			std::unique_lock<std::mutex> guard(p->lock);
+			p->done.wait(guard, [p]{ return p->finished == p->threads.size(); });
+			p->job = nullptr;
+		}
+		p->submit.unlock();
+	}
+}
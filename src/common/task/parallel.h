@@ -0,0 +1,22 @@
+#pragma once
+
+#include <inttypes.h>
+
+namespace task{
+	typedef void (*parallel_function)(void* user, uint32_t index);
+
+	// Hardware threads available, at least 1
+	uint32_t worker_count(void);
+
+	// Starts worker_count() - 1 pool threads that sleep between jobs. parallel_for
+	// starts the pool itself when it is not running. shutdown joins the threads
+	// and must not overlap a parallel_for
+	void initialize(void);
+	void shutdown(void);
+
+	// Runs fn once for every index in [0, count), spread over the pool with the
+	// calling thread taking part. Indices are handed out one at a time so uneven
+	// work balances itself. Returns once every index has completed. The pool runs
+	// one job at a time, a call made while it is busy runs on the caller alone
+	void parallel_for(uint32_t count, parallel_function fn, void* user);
+}
@@ -43,26 +43,10 @@ int main(int argc, const char** argv){
 
 	challenge.api.graphics.initialize(800, 600, "Test", false);
 	challenge.api.event.initialize_handler();
-
-	uint32_t shader = 0, texture = 0;
-	{
-		// Find a vertex shader, and a fragment shader
-		// Should only ever be one of each. Doesn't matter
-		// what they are named though since we are just searching
-		// for the extension
-		uint8_t buffer[1024];
-		uint32_t buffer_used = 0;
-		uint32_t nvs = challenge.api.file.find("./resource", ".vs", buffer, 1024, buffer_used);
-		uint32_t vs_buf_used = buffer_used;
-		uint32_t nfs = challenge.api.file.find("./resource", ".fs", buffer + vs_buf_used, 1024 - vs_buf_used, buffer_used);
-
-		// Load shader/texture if we have exactly one of each available
-		if (nvs == 1 && nfs == 1){
-			shader = load_shader((const char*)buffer, (const char*)(buffer + vs_buf_used));
-		}
-	}
-	// hardcoded relative path
-	texture = load_texture("./resource/codepage.png");
+	// The default shaders and codepage are built into the library, no file is touched
+	uint32_t shader = load_shader("./resource/shader.vs", "./resource/shader.fs");
+	uint32_t texture = load_texture("./resource/codepage.png");
+	challenge.api.file.prefetch_mark("assets");
 
 
 	challenge.api.buffer.initialize(1, 1024, shader, texture);
@@ -269,8 +253,8 @@ int main(int argc, const char** argv){
 		challenge.api.graphics.end_render();
 	}
 
-	challenge.api.shader.destroy_program(shader);
-	challenge.api.texture.destroy(texture);
+	challenge.api.resource.release_shader(shader);
+	challenge.api.resource.release_texture(texture);
 
 	challenge.api.buffer.shutdown();
 	challenge.api.event.shutdown_handler();
@@ -280,40 +264,12 @@ int main(int argc, const char** argv){
 	return 0;
 }
 
-// Load Vertex/Fragment shader files into memory then pass that data
-// into the shader program compiler
+// Shader sources are compiled once and shared through the resource cache
 uint32_t load_shader(const char* vpath, const char* fpath){
 	printf("Loading shader from: V[%s], F[%s]\n", vpath, fpath);
-	uint32_t result = 0;
-
-	uint32_t vsz = challenge.api.file.size(vpath);
-	uint32_t fsz = challenge.api.file.size(fpath);
-	
-	uint8_t *store = new uint8_t[vsz + fsz];
-	void* vdata = store;
-	void* fdata = store + vsz;
-
-	challenge.api.file.read(vpath, vdata, vsz);
-	challenge.api.file.read(fpath, fdata, fsz);
-
-	result = challenge.api.shader.create_program(vdata, fdata, 0, vsz, fsz, 0);
-
-	delete[] store;
-
-	return result;
+	return challenge.api.resource.load_shader(vpath, fpath);
 }
-// Load texture file into memory, then pass into texture loading to GPU
+// Texture file is decoded once and shared through the resource cache
 uint32_t load_texture(const char* path){
-	uint32_t result = 0;
-
-	uint32_t tsz = challenge.api.file.size(path);
-	uint8_t *store = new uint8_t[tsz];
-	void* tdata = store;
-
-	challenge.api.file.read(path, tdata, tsz);
-	result = challenge.api.texture.create_alpha(tdata, tsz);
-	
-	delete[] store;
-
-	return result;
+	return challenge.api.resource.load_texture(path, nullptr);
 }
@@ -0,0 +1,17 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "common/io/pack.h"
+
+// Builds a resource pack from a directory, names are stored relative to the
+// working directory so run it from where the game will run.
+// --lz4 compresses the files that get meaningfully smaller
+int main(int argc, const char** argv){
+	bool compress = argc == 4 && strcmp(argv[1], "--lz4") == 0;
+	if (argc != 3 + compress){
+		printf("usage: %s [--lz4] <output.pak> <resource directory>\n", argv[0]);
+		return 1;
+	}
+
+	return io::pack::build(argv[1 + compress], argv[2 + compress], compress) ? 0 : 1;
+}